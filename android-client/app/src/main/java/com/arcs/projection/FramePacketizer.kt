@@ -105,7 +105,7 @@ class FramePacketizer(
         totalFragments: Int = 1
     ): ByteArray {
         val hasFragmentInfo = isFragment
-        val headerSize = 22 + (if (hasFragmentInfo) 4 else 0)
+        val headerSize = 23 + (if (hasFragmentInfo) 4 else 0)
         val totalSize = headerSize + payload.size + 4  // +4 for CRC
         
         val packet = ByteArray(totalSize)
@@ -0,0 +1,248 @@
+#include "crc32.h"
+#include <array>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ARCS_CRC32_PCLMUL 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define ARCS_CRC32_ARMV8 1
+#include <arm_acle.h>
+#endif
+
+namespace arcs {
+namespace protocol {
+
+namespace {
+
+constexpr uint32_t POLYNOMIAL = 0xEDB88320u;
+
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+Tables make_tables() {
+    Tables tables;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            c = (c & 1) ? (c >> 1) ^ POLYNOMIAL : c >> 1;
+        }
+        tables[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (size_t k = 1; k < 8; ++k) {
+            uint32_t prev = tables[k - 1][i];
+            tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+const Tables& tables() {
+    static const Tables instance = make_tables();
+    return instance;
+}
+
+inline uint32_t load_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+/**
+ * Slice-by-8 over the inverted CRC state
+ */
+uint32_t update_slice8(uint32_t state, const uint8_t* data, size_t size) {
+    const Tables& t = tables();
+    
+    while (size >= 8) {
+        uint32_t one = load_le32(data) ^ state;
+        uint32_t two = load_le32(data + 4);
+        state = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^
+                t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+                t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^
+                t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+        data += 8;
+        size -= 8;
+    }
+    
+    while (size-- > 0) {
+        state = t[0][(state ^ *data++) & 0xFF] ^ (state >> 8);
+    }
+    return state;
+}
+
+#if defined(ARCS_CRC32_PCLMUL)
+
+constexpr size_t PCLMUL_MIN_SIZE = 64;
+
+/**
+ * Fold 16-byte lanes with carry-less multiplies, then Barrett-reduce
+ * (Gopal et al., "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ"). Requires size >= 64 and a multiple of 16; works on the
+ * inverted CRC state.
+ */
+__attribute__((target("sse4.1,pclmul")))
+uint32_t update_pclmul(uint32_t state, const uint8_t* data, size_t size) {
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+    
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(state)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    
+    data += 64;
+    size -= 64;
+    
+    // Four lanes in parallel
+    while (size >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+        
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        
+        data += 64;
+        size -= 64;
+    }
+    
+    // Fold the four lanes into one
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+    
+    // Remaining 16-byte blocks
+    while (size >= 16) {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        
+        data += 16;
+        size -= 16;
+    }
+    
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+bool has_pclmul() {
+    static const bool supported = __builtin_cpu_supports("pclmul") &&
+                                  __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+
+#endif
+
+#if defined(ARCS_CRC32_ARMV8)
+
+uint32_t update_armv8(uint32_t state, const uint8_t* data, size_t size) {
+    while (size >= 8) {
+        uint64_t word = 0;
+        for (int i = 7; i >= 0; --i) {
+            word = (word << 8) | data[i];
+        }
+        state = __crc32d(state, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        state = __crc32b(state, *data++);
+    }
+    return state;
+}
+
+#endif
+
+} // anonymous namespace
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    uint32_t state = ~crc;
+
+#if defined(ARCS_CRC32_ARMV8)
+    state = update_armv8(state, data, size);
+#else
+#if defined(ARCS_CRC32_PCLMUL)
+    if (size >= PCLMUL_MIN_SIZE && has_pclmul()) {
+        size_t bulk = size & ~static_cast<size_t>(15);
+        state = update_pclmul(state, data, bulk);
+        data += bulk;
+        size -= bulk;
+    }
+#endif
+    state = update_slice8(state, data, size);
+#endif
+
+    return ~state;
+}
+
+uint32_t crc32_slice8(const uint8_t* data, size_t size, uint32_t crc) {
+    return ~update_slice8(~crc, data, size);
+}
+
+const char* crc32_implementation() {
+#if defined(ARCS_CRC32_ARMV8)
+    return "armv8-crc";
+#elif defined(ARCS_CRC32_PCLMUL)
+    return has_pclmul() ? "pclmul" : "slice-by-8";
+#else
+    return "slice-by-8";
+#endif
+}
+
+} // namespace protocol
+} // namespace arcs
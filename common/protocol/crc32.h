@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace arcs {
+namespace protocol {
+
+/**
+ * CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320)
+ * Same result as zlib's crc32() and java.util.zip.CRC32. Pass the previous
+ * result as crc to continue a running checksum.
+ *
+ * Uses PCLMULQDQ folding on x86 (detected at runtime) or the ARMv8 CRC32
+ * instructions when the target has them, and slice-by-8 tables otherwise.
+ * SSE4.2's crc32 instruction computes CRC-32C, a different polynomial, so
+ * it cannot be used here.
+ */
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/**
+ * Portable slice-by-8 implementation (exposed for verification)
+ */
+uint32_t crc32_slice8(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/**
+ * Name of the implementation crc32() dispatches to
+ */
+const char* crc32_implementation();
+
+} // namespace protocol
+} // namespace arcs
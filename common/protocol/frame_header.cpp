@@ -0,0 +1,99 @@
+#include "frame_header.h"
+#include "crc32.h"
+
+namespace arcs {
+namespace protocol {
+
+namespace {
+
+inline uint16_t read_be16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t read_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) |
+           (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) |
+           static_cast<uint32_t>(p[3]);
+}
+
+inline uint64_t read_be64(const uint8_t* p) {
+    return (static_cast<uint64_t>(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+} // anonymous namespace
+
+bool has_frame_magic(const uint8_t* data, size_t size) {
+    return size >= 5 &&
+           data[0] == 'A' && data[1] == 'R' && data[2] == 'C' && data[3] == 'S' &&
+           data[4] == FRAME_VERSION;
+}
+
+FrameStatus parse_frame(
+    const uint8_t* data,
+    size_t size,
+    FrameHeader& header,
+    FrameValidation validation)
+{
+    if (size < FRAME_HEADER_SIZE + FRAME_CHECKSUM_SIZE) {
+        return FrameStatus::TRUNCATED;
+    }
+    if (data[0] != 'A' || data[1] != 'R' || data[2] != 'C' || data[3] != 'S') {
+        return FrameStatus::BAD_MAGIC;
+    }
+    if (data[4] != FRAME_VERSION) {
+        return FrameStatus::BAD_VERSION;
+    }
+    
+    header.version = data[4];
+    header.type = data[5];
+    header.frame_number = read_be32(data + 6);
+    header.timestamp_us = read_be64(data + 10);
+    header.flags = data[18];
+    header.payload_size = read_be32(data + 19);
+    header.fragment_index = 0;
+    header.fragment_count = 1;
+    header.payload_offset = FRAME_HEADER_SIZE;
+    
+    if (header.is_fragment()) {
+        if (size < FRAME_HEADER_SIZE + FRAME_FRAGMENT_INFO_SIZE + FRAME_CHECKSUM_SIZE) {
+            return FrameStatus::TRUNCATED;
+        }
+        header.fragment_index = read_be16(data + FRAME_HEADER_SIZE);
+        header.fragment_count = read_be16(data + FRAME_HEADER_SIZE + 2);
+        header.payload_offset += FRAME_FRAGMENT_INFO_SIZE;
+        
+        if (header.fragment_count == 0 || header.fragment_index >= header.fragment_count) {
+            return FrameStatus::BAD_LENGTH;
+        }
+    }
+    
+    // Exactly one frame per message
+    if (size - header.payload_offset - FRAME_CHECKSUM_SIZE != header.payload_size) {
+        return FrameStatus::BAD_LENGTH;
+    }
+    
+    if (validation == FrameValidation::CHECKSUM) {
+        size_t covered = size - FRAME_CHECKSUM_SIZE;
+        if (crc32(data, covered) != read_be32(data + covered)) {
+            return FrameStatus::BAD_CHECKSUM;
+        }
+    }
+    
+    return FrameStatus::OK;
+}
+
+const char* frame_status_to_string(FrameStatus status) {
+    switch (status) {
+        case FrameStatus::OK: return "OK";
+        case FrameStatus::TRUNCATED: return "TRUNCATED";
+        case FrameStatus::BAD_MAGIC: return "BAD_MAGIC";
+        case FrameStatus::BAD_VERSION: return "BAD_VERSION";
+        case FrameStatus::BAD_LENGTH: return "BAD_LENGTH";
+        case FrameStatus::BAD_CHECKSUM: return "BAD_CHECKSUM";
+        default: return "UNKNOWN";
+    }
+}
+
+} // namespace protocol
+} // namespace arcs
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace arcs {
+namespace protocol {
+
+/**
+ * ARCS binary frame (docs/protocol.md), all fields big-endian:
+ *
+ *   [Magic "ARCS":4][Version:1][Type:1][Frame Number:4][Timestamp:8]
+ *   [Flags:1][Payload Length:4][Fragment Info:4, if fragment][Payload:N]
+ *   [CRC32:4]
+ *
+ * The CRC covers every byte before it, header included.
+ */
+constexpr uint8_t FRAME_VERSION = 0x01;
+constexpr uint8_t FRAME_TYPE_VIDEO = 0x02;
+constexpr uint8_t FRAME_TYPE_CONTROL = 0x03;
+
+constexpr uint8_t FRAME_FLAG_KEYFRAME = 0x01;
+constexpr uint8_t FRAME_FLAG_ENCRYPTED = 0x02;
+constexpr uint8_t FRAME_FLAG_FRAGMENT = 0x04;
+
+constexpr size_t FRAME_HEADER_SIZE = 23;
+constexpr size_t FRAME_FRAGMENT_INFO_SIZE = 4;
+constexpr size_t FRAME_CHECKSUM_SIZE = 4;
+
+/**
+ * Decoded frame header
+ */
+struct FrameHeader {
+    uint8_t version;
+    uint8_t type;
+    uint32_t frame_number;
+    uint64_t timestamp_us;
+    uint8_t flags;
+    uint32_t payload_size;
+    uint16_t fragment_index;    // 0 unless FRAME_FLAG_FRAGMENT
+    uint16_t fragment_count;    // 1 unless FRAME_FLAG_FRAGMENT
+    size_t payload_offset;      // Payload starts at data + payload_offset
+    
+    bool is_keyframe() const { return (flags & FRAME_FLAG_KEYFRAME) != 0; }
+    bool is_encrypted() const { return (flags & FRAME_FLAG_ENCRYPTED) != 0; }
+    bool is_fragment() const { return (flags & FRAME_FLAG_FRAGMENT) != 0; }
+};
+
+enum class FrameStatus {
+    OK,
+    TRUNCATED,
+    BAD_MAGIC,
+    BAD_VERSION,
+    BAD_LENGTH,
+    BAD_CHECKSUM
+};
+
+/**
+ * Per-hop validation
+ * Ingress checks the CRC once; later hops that received the frame from a
+ * validating peer can pass TRUSTED and only parse the header.
+ */
+enum class FrameValidation {
+    CHECKSUM,
+    TRUSTED
+};
+
+/**
+ * Parse and optionally validate one frame
+ * The header is only meaningful when OK is returned.
+ */
+FrameStatus parse_frame(const uint8_t* data,
+                        size_t size,
+                        FrameHeader& header,
+                        FrameValidation validation = FrameValidation::CHECKSUM);
+
+/**
+ * Quick check for the ARCS magic and version, without parsing
+ */
+bool has_frame_magic(const uint8_t* data, size_t size);
+
+const char* frame_status_to_string(FrameStatus status);
+
+} // namespace protocol
+} // namespace arcs
@@ -0,0 +1,133 @@
+#include "frame_buffer.h"
+#include <mutex>
+#include <vector>
+
+struct FrameBufferPool::Buffer {
+    std::unique_ptr<uint8_t[]> storage;
+    uint8_t* data = nullptr;        // storage rounded up to BUFFER_ALIGNMENT
+    size_t capacity = 0;
+    std::shared_ptr<State> owner;   // Held while an image uses the buffer
+};
+
+struct FrameBufferPool::State {
+    explicit State(size_t maxIdle)
+        : maxIdle(maxIdle),
+          allocations(0)
+    {
+        idle.reserve(maxIdle);
+    }
+    
+    ~State() {
+        for (Buffer* buffer : idle) {
+            delete buffer;
+        }
+    }
+    
+    std::mutex mutex;
+    std::vector<Buffer*> idle;
+    size_t maxIdle;
+    uint64_t allocations;
+};
+
+FrameBufferPool::FrameBufferPool(size_t maxIdle)
+    : state_(std::make_shared<State>(maxIdle))
+{
+}
+
+FrameBufferPool::~FrameBufferPool() = default;
+
+QImage FrameBufferPool::acquire(int width, int height, QImage::Format format) {
+    if (width <= 0 || height <= 0) {
+        return QImage();
+    }
+    
+    size_t bitsPerPixel = QImage::toPixelFormat(format).bitsPerPixel();
+    size_t bytesPerLine = (static_cast<size_t>(width) * bitsPerPixel + 7) / 8;
+    bytesPerLine = (bytesPerLine + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+    size_t needed = bytesPerLine * static_cast<size_t>(height);
+    
+    Buffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->idle.empty()) {
+            buffer = state_->idle.back();
+            state_->idle.pop_back();
+        }
+        if (!buffer || buffer->capacity < needed) {
+            state_->allocations++;
+        }
+    }
+    
+    if (!buffer) {
+        buffer = new Buffer();
+    }
+    if (buffer->capacity < needed) {
+        buffer->storage.reset(new uint8_t[needed + BUFFER_ALIGNMENT]);
+        auto address = reinterpret_cast<uintptr_t>(buffer->storage.get());
+        address = (address + BUFFER_ALIGNMENT - 1) & ~static_cast<uintptr_t>(BUFFER_ALIGNMENT - 1);
+        buffer->data = reinterpret_cast<uint8_t*>(address);
+        buffer->capacity = needed;
+    }
+    buffer->owner = state_;
+    
+    return QImage(
+        buffer->data,
+        width,
+        height,
+        static_cast<qsizetype>(bytesPerLine),
+        format,
+        &FrameBufferPool::release,
+        buffer
+    );
+}
+
+uint64_t FrameBufferPool::allocations() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->allocations;
+}
+
+void FrameBufferPool::release(void* info) {
+    // Called by QImage from whichever thread drops the last reference.
+    // The moved-out owner keeps the state alive until the lock is gone.
+    Buffer* buffer = static_cast<Buffer*>(info);
+    std::shared_ptr<State> state = std::move(buffer->owner);
+    
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->idle.size() < state->maxIdle) {
+        state->idle.push_back(buffer);
+    } else {
+        delete buffer;
+    }
+}
+
+FrameMailbox::FrameMailbox()
+    : back_(0),
+      front_(2),
+      middle_(1),
+      published_(0),
+      skipped_(0)
+{
+}
+
+bool FrameMailbox::publish() {
+    uint8_t previous = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+    back_ = previous & SLOT_MASK;
+    published_.fetch_add(1, std::memory_order_relaxed);
+    
+    if (previous & FRESH) {
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+DecodedFrame* FrameMailbox::take() {
+    if (!(middle_.load(std::memory_order_acquire) & FRESH)) {
+        return nullptr;
+    }
+    
+    // Only the producer sets FRESH, so the swapped-out slot is the newest
+    uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & SLOT_MASK;
+    return &slots_[front_];
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QImage>
+#include <QSize>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Recycling pool of frame buffers
+ * acquire() hands out QImages whose pixel storage belongs to the pool.
+ * When the last copy of an image is destroyed its storage goes back on
+ * the idle list, so once the pool is warm decoding allocates no frame
+ * buffers. Images may outlive the pool.
+ */
+class FrameBufferPool {
+public:
+    /**
+     * Constructor
+     * @param maxIdle Buffers kept for reuse; extra released buffers are freed
+     */
+    explicit FrameBufferPool(size_t maxIdle = 8);
+    ~FrameBufferPool();
+    
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+    
+    /**
+     * Get an image backed by pooled storage
+     * Contents are undefined; scan lines are padded to BUFFER_ALIGNMENT.
+     */
+    QImage acquire(int width, int height, QImage::Format format);
+    
+    /**
+     * Buffers allocated (or grown) so far
+     */
+    uint64_t allocations() const;
+    
+    static constexpr size_t BUFFER_ALIGNMENT = 64;
+
+private:
+    struct Buffer;
+    struct State;
+    
+    static void release(void* info);
+    
+    std::shared_ptr<State> state_;
+};
+
+/**
+ * Decoded frame handed to the GUI thread
+ */
+struct DecodedFrame {
+    QImage image;               // RGB output, scaled to the display
+    QSize sourceSize;           // Stream resolution
+};
+
+/**
+ * Latest-frame-wins mailbox between the decoder and the GUI thread
+ * A triple buffer: the decoder fills the back slot and swaps it into the
+ * middle, the widget swaps the middle out when it paints. A frame still
+ * waiting in the middle when the next one lands is replaced and counted
+ * as skipped. One producer and one consumer; neither side blocks.
+ */
+class FrameMailbox {
+public:
+    FrameMailbox();
+    
+    FrameMailbox(const FrameMailbox&) = delete;
+    FrameMailbox& operator=(const FrameMailbox&) = delete;
+    
+    /**
+     * Producer: slot to fill before publish()
+     */
+    DecodedFrame& back() { return slots_[back_]; }
+    
+    /**
+     * Producer: make the back slot the newest frame
+     * @return true if no frame was waiting, so the consumer needs waking
+     */
+    bool publish();
+    
+    /**
+     * Consumer: newest frame published since the last take, or nullptr
+     * Valid until the next take().
+     */
+    DecodedFrame* take();
+    
+    uint64_t published() const { return published_.load(std::memory_order_relaxed); }
+    uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint8_t SLOT_MASK = 0x03;
+    static constexpr uint8_t FRESH = 0x04;  // Middle slot not yet taken
+    
+    DecodedFrame slots_[3];
+    uint8_t back_;                  // Producer only
+    uint8_t front_;                 // Consumer only
+    std::atomic<uint8_t> middle_;   // Slot index | FRESH
+    
+    std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> skipped_;
+};
@@ -1,5 +1,14 @@
 #include "video_decoder.h"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+constexpr double DECODE_EWMA_WEIGHT = 1.0 / 16;
+
+} // anonymous namespace
 
 VideoDecoder::VideoDecoder(QObject *parent)
     : QObject(parent),
@@ -10,13 +19,22 @@ VideoDecoder::VideoDecoder(QObject *parent)
       packet_(nullptr),
       swsCtx_(nullptr),
       initialized_(false),
+      frameValidation_(arcs::protocol::FrameValidation::TRUSTED),
       frameWidth_(0),
-      frameHeight_(0)
+      frameHeight_(0),
+      outputWidth_(0),
+      outputHeight_(0),
+      mailbox_(std::make_shared<FrameMailbox>()),
+      awaitingKeyframe_(false),
+      flushRequested_(false),
+      stopping_(false)
 {
     initialize();
 }
 
 VideoDecoder::~VideoDecoder() {
+    stopWorker();
+    
     if (swsCtx_) {
         sws_freeContext(swsCtx_);
     }
@@ -56,6 +74,13 @@ bool VideoDecoder::initialize() {
         return false;
     }
     
+    // Interactive stream: let libavcodec size the thread pool and hand
+    // out each frame as soon as it is complete. Frame threading holds one
+    // frame per thread, so under LOW_DELAY libavcodec uses slice threads.
+    codecCtx_->thread_count = 0;
+    codecCtx_->thread_type = FF_THREAD_SLICE | FF_THREAD_FRAME;
+    codecCtx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    
     // Open codec
     if (avcodec_open2(codecCtx_, codec_, nullptr) < 0) {
         emit decodingError("Failed to open codec");
@@ -72,7 +97,9 @@ bool VideoDecoder::initialize() {
     }
     
     initialized_ = true;
-    std::cout << "Video decoder initialized" << std::endl;
+    worker_ = std::thread(&VideoDecoder::decodeLoop, this);
+    std::cout << "Video decoder initialized (" << codecCtx_->thread_count
+              << " threads)" << std::endl;
     
     return true;
 }
@@ -82,11 +109,116 @@ void VideoDecoder::decodeFrame(const uint8_t* data, size_t size) {
         return;
     }
     
+    // Strip the ARCS header; the relay has already checked the CRC
+    bool keyframe = true;  // Raw H.264 carries no flags to wait for
+    if (arcs::protocol::has_frame_magic(data, size)) {
+        arcs::protocol::FrameHeader header;
+        arcs::protocol::FrameStatus status =
+            arcs::protocol::parse_frame(data, size, header, frameValidation_.load());
+        if (status != arcs::protocol::FrameStatus::OK) {
+            emit decodingError(QString("Invalid frame: %1")
+                .arg(arcs::protocol::frame_status_to_string(status)));
+            return;
+        }
+        data += header.payload_offset;
+        size = header.payload_size;
+        keyframe = header.is_keyframe();
+    }
+    
+    if (size == 0) {
+        return;
+    }
+    
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        
+        // Decoder is behind; skip to the next keyframe rather than decode
+        // an ever older backlog
+        if (queue_.size() >= MAX_QUEUED_PACKETS) {
+            dropped = queue_.size();
+            for (auto& queued : queue_) {
+                sparePackets_.push_back(std::move(queued));
+            }
+            queue_.clear();
+            awaitingKeyframe_ = true;
+            flushRequested_ = true;
+        }
+        
+        if (awaitingKeyframe_ && !keyframe) {
+            dropped++;
+        } else {
+            awaitingKeyframe_ = false;
+            
+            Packet packet;
+            if (!sparePackets_.empty()) {
+                packet = std::move(sparePackets_.back());
+                sparePackets_.pop_back();
+            }
+            packet.data.resize(size + AV_INPUT_BUFFER_PADDING_SIZE);
+            std::memcpy(packet.data.data(), data, size);
+            std::memset(packet.data.data() + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+            packet.size = size;
+            queue_.push_back(std::move(packet));
+        }
+    }
+    queueCv_.notify_one();
+    
+    if (dropped > 0) {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.packetsDropped += dropped;
+    }
+}
+
+void VideoDecoder::decodeLoop() {
+    Packet packet;
+    
+    while (true) {
+        bool flush = false;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            if (packet.data.capacity() > 0) {
+                sparePackets_.push_back(std::move(packet));
+                packet = Packet();
+            }
+            queueCv_.wait(lock, [this] {
+                return stopping_ || flushRequested_ || !queue_.empty();
+            });
+            if (stopping_) {
+                return;
+            }
+            
+            flush = flushRequested_;
+            flushRequested_ = false;
+            if (!queue_.empty()) {
+                packet = std::move(queue_.front());
+                queue_.pop_front();
+            }
+        }
+        
+        if (flush) {
+            avcodec_flush_buffers(codecCtx_);
+            
+            // The parser still holds the partial NAL from before the gap;
+            // a fresh one starts clean at the next keyframe
+            av_parser_close(parser_);
+            parser_ = av_parser_init(codec_->id);
+            if (!parser_) {
+                emit decodingError("Failed to reinitialize parser");
+            }
+        }
+        if (packet.size > 0) {
+            decodePacket(packet.data.data(), packet.size);
+        }
+    }
+}
+
+void VideoDecoder::decodePacket(const uint8_t* data, size_t size) {
     // Parse data
     uint8_t* parseData = const_cast<uint8_t*>(data);
     int parseSize = static_cast<int>(size);
     
-    while (parseSize > 0) {
+    while (parser_ && parseSize > 0) {
         int ret = av_parser_parse2(
             parser_,
             codecCtx_,
@@ -108,7 +240,9 @@ void VideoDecoder::decodeFrame(const uint8_t* data, size_t size) {
         parseSize -= ret;
         
         if (packet_->size > 0) {
-            // Decode packet
+            // Decode packet. send_packet may already decode the first
+            // frame, so its time counts towards that frame.
+            auto decodeStart = std::chrono::steady_clock::now();
             ret = avcodec_send_packet(codecCtx_, packet_);
             if (ret < 0) {
                 emit decodingError("Error sending packet for decoding");
@@ -125,22 +259,40 @@ void VideoDecoder::decodeFrame(const uint8_t* data, size_t size) {
                     break;
                 }
                 
-                // Update frame dimensions if changed
-                if (frame_->width != frameWidth_ || frame_->height != frameHeight_) {
+                auto convertStart = std::chrono::steady_clock::now();
+                double decodeMs = std::chrono::duration<double, std::milli>(
+                    convertStart - decodeStart).count();
+                
+                // Scale to fit the display area, or keep the stream size
+                // until the widget has reported one
+                QSize outputSize(frame_->width, frame_->height);
+                {
+                    std::lock_guard<std::mutex> lock(outputSizeMutex_);
+                    if (!displaySize_.isEmpty()) {
+                        outputSize = outputSize.scaled(displaySize_, Qt::KeepAspectRatio);
+                    }
+                }
+                
+                // Rebuild the conversion context only when either size changes
+                if (frame_->width != frameWidth_ || frame_->height != frameHeight_ ||
+                    outputSize.width() != outputWidth_ || outputSize.height() != outputHeight_) {
                     frameWidth_ = frame_->width;
                     frameHeight_ = frame_->height;
+                    outputWidth_ = outputSize.width();
+                    outputHeight_ = outputSize.height();
                     
                     if (swsCtx_) {
                         sws_freeContext(swsCtx_);
                     }
                     
-                    // Create conversion context
+                    // Create conversion context; colour conversion and
+                    // scaling happen in the same pass
                     swsCtx_ = sws_getContext(
                         frameWidth_,
                         frameHeight_,
                         codecCtx_->pix_fmt,
-                        frameWidth_,
-                        frameHeight_,
+                        outputWidth_,
+                        outputHeight_,
                         AV_PIX_FMT_RGB24,
                         SWS_BILINEAR,
                         nullptr,
@@ -151,17 +303,96 @@ void VideoDecoder::decodeFrame(const uint8_t* data, size_t size) {
                 
                 // Convert frame to QImage
                 QImage image = avFrameToQImage(frame_);
+                recordFrameTimes(decodeMs, std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - convertStart).count());
                 if (!image.isNull()) {
-                    emit frameDecoded(image);
+                    deliverFrame(image);
                 }
+                
+                // Next frame's decode time starts at its receive_frame
+                decodeStart = std::chrono::steady_clock::now();
             }
         }
     }
 }
 
+void VideoDecoder::setVerifyChecksums(bool verify) {
+    frameValidation_ = verify ? arcs::protocol::FrameValidation::CHECKSUM
+                              : arcs::protocol::FrameValidation::TRUSTED;
+}
+
+void VideoDecoder::setOutputSize(const QSize& size) {
+    std::lock_guard<std::mutex> lock(outputSizeMutex_);
+    displaySize_ = size;
+}
+
 void VideoDecoder::reset() {
-    if (codecCtx_) {
-        avcodec_flush_buffers(codecCtx_);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        for (auto& queued : queue_) {
+            sparePackets_.push_back(std::move(queued));
+        }
+        queue_.clear();
+        awaitingKeyframe_ = false;
+        flushRequested_ = true;
+    }
+    queueCv_.notify_one();
+}
+
+VideoDecoder::Stats VideoDecoder::stats() const {
+    Stats snapshot;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        snapshot = stats_;
+    }
+    snapshot.bufferAllocations = framePool_.allocations();
+    snapshot.framesSkipped = mailbox_->skipped();
+    return snapshot;
+}
+
+std::shared_ptr<FrameMailbox> VideoDecoder::frameMailbox() const {
+    return mailbox_;
+}
+
+void VideoDecoder::deliverFrame(const QImage& image) {
+    // Overwrites whatever the slot held last; a frame the GUI never took
+    // is counted as skipped by the mailbox
+    DecodedFrame& slot = mailbox_->back();
+    slot.image = image;
+    slot.sourceSize = QSize(frame_->width, frame_->height);
+    
+    if (mailbox_->publish()) {
+        emit frameAvailable();
+    }
+}
+
+void VideoDecoder::recordFrameTimes(double decodeMs, double convertMs) {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.framesDecoded++;
+    bool first = stats_.framesDecoded == 1;
+    
+    stats_.lastDecodeMs = decodeMs;
+    stats_.maxDecodeMs = std::max(stats_.maxDecodeMs, decodeMs);
+    stats_.avgDecodeMs = first
+        ? decodeMs
+        : stats_.avgDecodeMs + DECODE_EWMA_WEIGHT * (decodeMs - stats_.avgDecodeMs);
+    
+    stats_.lastConvertMs = convertMs;
+    stats_.maxConvertMs = std::max(stats_.maxConvertMs, convertMs);
+    stats_.avgConvertMs = first
+        ? convertMs
+        : stats_.avgConvertMs + DECODE_EWMA_WEIGHT * (convertMs - stats_.avgConvertMs);
+}
+
+void VideoDecoder::stopWorker() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        stopping_ = true;
+    }
+    queueCv_.notify_one();
+    
+    if (worker_.joinable()) {
+        worker_.join();
     }
 }
 
@@ -170,20 +401,16 @@ QImage VideoDecoder::avFrameToQImage(AVFrame* frame) {
         return QImage();
     }
     
-    // Allocate RGB buffer
-    int numBytes = av_image_get_buffer_size(
-        AV_PIX_FMT_RGB24,
-        frameWidth_,
-        frameHeight_,
-        1
-    );
-    
-    std::vector<uint8_t> buffer(numBytes);
+    // Convert YUV to RGB straight into pooled image storage; the buffer
+    // returns to the pool once the UI drops its last copy of the image
+    QImage image = framePool_.acquire(outputWidth_, outputHeight_, QImage::Format_RGB888);
+    if (image.isNull()) {
+        return image;
+    }
     
-    uint8_t* dest[4] = {buffer.data(), nullptr, nullptr, nullptr};
-    int destLinesize[4] = {frameWidth_ * 3, 0, 0, 0};
+    uint8_t* dest[4] = {image.bits(), nullptr, nullptr, nullptr};
+    int destLinesize[4] = {static_cast<int>(image.bytesPerLine()), 0, 0, 0};
     
-    // Convert YUV to RGB
     sws_scale(
         swsCtx_,
         frame->data,
@@ -194,14 +421,5 @@ QImage VideoDecoder::avFrameToQImage(AVFrame* frame) {
         destLinesize
     );
     
-    // Create QImage
-    QImage image(
-        buffer.data(),
-        frameWidth_,
-        frameHeight_,
-        frameWidth_ * 3,
-        QImage::Format_RGB888
-    );
-    
-    return image.copy();
+    return image;
 }
@@ -3,6 +3,14 @@
 #include <QObject>
 #include <QImage>
 #include <memory>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "frame_buffer.h"
+#include "protocol/frame_header.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -13,24 +21,96 @@ extern "C" {
 
 /**
  * FFmpeg-based H.264 video decoder
+ * Messages are queued by the network thread and decoded on a dedicated
+ * worker. Decoded frames go to frameMailbox(), which only keeps the
+ * newest; frameAvailable and decodingError are emitted from the worker.
  */
 class VideoDecoder : public QObject {
     Q_OBJECT
 
 public:
+    /**
+     * Decoder statistics
+     */
+    struct Stats {
+        uint64_t framesDecoded = 0;
+        uint64_t packetsDropped = 0;    // Discarded on queue overflow
+        double lastDecodeMs = 0.0;      // Codec time for one frame
+        double avgDecodeMs = 0.0;       // Moving average
+        double maxDecodeMs = 0.0;
+        double lastConvertMs = 0.0;     // Colour conversion and scaling
+        double avgConvertMs = 0.0;      // Moving average
+        double maxConvertMs = 0.0;
+        uint64_t bufferAllocations = 0; // Frame buffers allocated by the pool
+        uint64_t framesSkipped = 0;     // Replaced in the mailbox before display
+    };
+    
     explicit VideoDecoder(QObject *parent = nullptr);
     ~VideoDecoder();
     
     bool initialize();
+    
+    /**
+     * Queue one message from the server for decoding
+     * ARCS-framed messages have their header stripped (and CRC checked if
+     * enabled) on the calling thread; anything else is treated as raw
+     * H.264. If the decoder falls behind and the queue fills, queued
+     * packets are dropped and decoding resumes at the next keyframe.
+     */
     void decodeFrame(const uint8_t* data, size_t size);
+    
+    /**
+     * Drop queued packets and flush the codec
+     */
     void reset();
+    
+    /**
+     * Check frame CRCs here as well as at the relay (off by default; the
+     * server validates once at ingress)
+     */
+    void setVerifyChecksums(bool verify);
+    
+    /**
+     * Area RGB frames are scaled into, keeping aspect ratio
+     * An empty size keeps the stream resolution.
+     */
+    void setOutputSize(const QSize& size);
+    
+    /**
+     * Snapshot of decoder statistics
+     */
+    Stats stats() const;
+    
+    /**
+     * Newest decoded frame, for the GUI thread to take when it paints
+     */
+    std::shared_ptr<FrameMailbox> frameMailbox() const;
 
 signals:
-    void frameDecoded(const QImage& frame);
+    /**
+     * A frame is waiting in the mailbox; not emitted again until it has
+     * been taken, so at most one notification is ever queued
+     */
+    void frameAvailable();
     void decodingError(const QString& error);
 
 private:
+    /**
+     * Queued payload; data carries zeroed FFmpeg input padding after size
+     */
+    struct Packet {
+        std::vector<uint8_t> data;
+        size_t size = 0;
+    };
+    
+    static constexpr size_t MAX_QUEUED_PACKETS = 32;
+    
+    void decodeLoop();
+    void decodePacket(const uint8_t* data, size_t size);
+    void recordFrameTimes(double decodeMs, double convertMs);
+    void stopWorker();
     QImage avFrameToQImage(AVFrame* frame);
+    void deliverFrame(const QImage& image);
     
     AVCodec* codec_;
     AVCodecContext* codecCtx_;
@@ -40,6 +120,26 @@ private:
     SwsContext* swsCtx_;
     
     bool initialized_;
+    std::atomic<arcs::protocol::FrameValidation> frameValidation_;  // Set on GUI thread
     int frameWidth_;
     int frameHeight_;
+    int outputWidth_;
+    int outputHeight_;
+    QSize displaySize_;
+    std::mutex outputSizeMutex_;
+    FrameBufferPool framePool_;
+    std::shared_ptr<FrameMailbox> mailbox_;
+    
+    // Packet queue; spare packets are recycled to keep buffers allocated
+    std::deque<Packet> queue_;
+    std::vector<Packet> sparePackets_;
+    bool awaitingKeyframe_;
+    bool flushRequested_;
+    bool stopping_;
+    std::mutex queueMutex_;
+    std::condition_variable queueCv_;
+    std::thread worker_;
+    
+    Stats stats_;
+    mutable std::mutex statsMutex_;
 };
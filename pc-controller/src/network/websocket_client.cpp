@@ -1,10 +1,62 @@
 #include "websocket_client.h"
 #include "../decoder/video_decoder.h"
 #include <iostream>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Compact binary control message (docs/protocol.md)
+// [Magic:4]["ARCS"][Version:1][Type:1][Command:1][Action:1][Args]
+constexpr uint8_t CONTROL_VERSION = 0x01;
+constexpr uint8_t CONTROL_TYPE = 0x03;
+constexpr uint8_t CONTROL_TOUCH = 0x01;
+constexpr uint8_t CONTROL_KEY = 0x02;
+constexpr uint8_t CONTROL_SYSTEM = 0x03;
+constexpr size_t CONTROL_HEADER_SIZE = 8;
+
+void writeControlHeader(uint8_t* out, uint8_t command, uint8_t action) {
+    out[0] = 'A';
+    out[1] = 'R';
+    out[2] = 'C';
+    out[3] = 'S';
+    out[4] = CONTROL_VERSION;
+    out[5] = CONTROL_TYPE;
+    out[6] = command;
+    out[7] = action;
+}
+
+void writeU16(uint8_t* out, float value) {
+    auto v = static_cast<uint16_t>(std::clamp(std::lround(value), 0L, 65535L));
+    out[0] = static_cast<uint8_t>(v >> 8);
+    out[1] = static_cast<uint8_t>(v);
+}
+
+uint8_t touchActionCode(const QString& action) {
+    if (action == "tap") return 0x01;
+    if (action == "long_press") return 0x02;
+    if (action == "swipe") return 0x03;
+    return 0;
+}
+
+uint8_t systemActionCode(const QString& action) {
+    if (action == "home") return 0x01;
+    if (action == "back") return 0x02;
+    if (action == "recents") return 0x03;
+    if (action == "notifications") return 0x04;
+    if (action == "quick_settings") return 0x05;
+    if (action == "lock") return 0x06;
+    if (action == "screenshot") return 0x07;
+    return 0;
+}
+
+} // namespace
 
 WebSocketClient::WebSocketClient(QObject *parent)
     : QObject(parent),
-      isConnected_(false)
+      isConnected_(false),
+      binaryControl_(false)
 {
     // Initialize WebSocket client
     wsClient_.init_asio();
@@ -17,8 +69,8 @@ WebSocketClient::WebSocketClient(QObject *parent)
     decoder_ = std::make_shared<VideoDecoder>();
     
     // Connect decoder signals
-    connect(decoder_.get(), &VideoDecoder::frameDecoded,
-            this, &WebSocketClient::videoFrameReceived);
+    connect(decoder_.get(), &VideoDecoder::frameAvailable,
+            this, &WebSocketClient::videoFrameAvailable);
 }
 
 WebSocketClient::~WebSocketClient() {
@@ -69,7 +121,24 @@ void WebSocketClient::disconnect() {
     }
 }
 
-void WebSocketClient::sendTouchCommand(const QString& action, float x, float y, int duration) {
+void WebSocketClient::sendTouchCommand(
+    const QString& action, float x, float y, int duration, float endX, float endY)
+{
+    uint8_t actionCode = touchActionCode(action);
+    if (binaryControl_ && actionCode != 0) {
+        std::array<uint8_t, CONTROL_HEADER_SIZE + 10> packet;
+        writeControlHeader(packet.data(), CONTROL_TOUCH, actionCode);
+        uint8_t* args = packet.data() + CONTROL_HEADER_SIZE;
+        writeU16(args, x);
+        writeU16(args + 2, y);
+        bool swipe = action == "swipe";
+        writeU16(args + 4, swipe ? endX : 0);
+        writeU16(args + 6, swipe ? endY : 0);
+        writeU16(args + 8, static_cast<float>(duration));
+        sendBinary(packet.data(), packet.size());
+        return;
+    }
+    
     json cmd = {
         {"type", "touch"},
         {"action", action.toStdString()}
@@ -84,14 +153,28 @@ void WebSocketClient::sendTouchCommand(const QString& action, float x, float y,
     } else if (action == "swipe") {
         cmd["start_x"] = x;
         cmd["start_y"] = y;
-        cmd["end_x"] = x + duration; // Using duration as delta
-        cmd["end_y"] = y;
+        cmd["end_x"] = endX;
+        cmd["end_y"] = endY;
+        cmd["duration"] = duration;
     }
     
     sendMessage(cmd);
 }
 
 void WebSocketClient::sendKeyCommand(const QString& action, int keycode, const QString& text) {
+    // Text input is variable-length and stays JSON
+    if (binaryControl_ && action == "press") {
+        std::array<uint8_t, CONTROL_HEADER_SIZE + 4> packet;
+        writeControlHeader(packet.data(), CONTROL_KEY, 0x01);
+        auto code = static_cast<uint32_t>(keycode);
+        packet[8] = static_cast<uint8_t>(code >> 24);
+        packet[9] = static_cast<uint8_t>(code >> 16);
+        packet[10] = static_cast<uint8_t>(code >> 8);
+        packet[11] = static_cast<uint8_t>(code);
+        sendBinary(packet.data(), packet.size());
+        return;
+    }
+    
     json cmd = {
         {"type", "key"},
         {"action", action.toStdString()}
@@ -107,6 +190,14 @@ void WebSocketClient::sendKeyCommand(const QString& action, int keycode, const Q
 }
 
 void WebSocketClient::sendSystemCommand(const QString& action) {
+    uint8_t actionCode = systemActionCode(action);
+    if (binaryControl_ && actionCode != 0) {
+        std::array<uint8_t, CONTROL_HEADER_SIZE> packet;
+        writeControlHeader(packet.data(), CONTROL_SYSTEM, actionCode);
+        sendBinary(packet.data(), packet.size());
+        return;
+    }
+    
     json cmd = {
         {"type", "system"},
         {"action", action.toStdString()}
@@ -122,15 +213,25 @@ void WebSocketClient::onOpen(connection_hdl hdl) {
     json joinMsg = {
         {"type", "join_session"},
         {"session_id", sessionId_.toStdString()},
-        {"jwt_token", jwtToken_.toStdString()}
+        {"jwt_token", jwtToken_.toStdString()},
+        {"capabilities", {
+            {"binary_control", true}
+        }}
     };
     
-    sendMessage(joinMsg);
+    // isConnected_ is only set once the server acks the join, so
+    // sendMessage would drop it; send on the open handle directly
+    websocketpp::lib::error_code ec;
+    wsClient_.send(hdl, joinMsg.dump(), websocketpp::frame::opcode::text, ec);
+    if (ec) {
+        std::cerr << "Join send error: " << ec.message() << std::endl;
+    }
 }
 
 void WebSocketClient::onClose(connection_hdl hdl) {
     std::cout << "Connection closed" << std::endl;
     isConnected_ = false;
+    binaryControl_ = false;
     emit disconnected();
 }
 
@@ -159,6 +260,10 @@ void WebSocketClient::handleJsonMessage(const std::string& message) {
             if (success) {
                 isConnected_ = true;
                 
+                // Binary commands only once the server has confirmed them
+                binaryControl_ = msg.contains("capabilities") &&
+                    msg["capabilities"].value("binary_control", false);
+                
                 // Extract device info
                 if (msg.contains("device_info")) {
                     auto devInfo = msg["device_info"];
@@ -182,6 +287,14 @@ void WebSocketClient::handleJsonMessage(const std::string& message) {
     }
 }
 
+void WebSocketClient::setVideoOutputSize(const QSize& size) {
+    decoder_->setOutputSize(size);
+}
+
+std::shared_ptr<FrameMailbox> WebSocketClient::frameMailbox() const {
+    return decoder_->frameMailbox();
+}
+
 void WebSocketClient::handleBinaryMessage(const std::string& message) {
     // Decode video frame
     const uint8_t* data = reinterpret_cast<const uint8_t*>(message.data());
@@ -205,3 +318,16 @@ void WebSocketClient::sendMessage(const json& msg) {
         std::cerr << "Send exception: " << e.what() << std::endl;
     }
 }
+
+void WebSocketClient::sendBinary(const uint8_t* data, size_t size) {
+    if (!isConnected_) {
+        return;
+    }
+    
+    websocketpp::lib::error_code ec;
+    wsClient_.send(connection_, data, size, websocketpp::frame::opcode::binary, ec);
+    
+    if (ec) {
+        std::cerr << "Send error: " << ec.message() << std::endl;
+    }
+}
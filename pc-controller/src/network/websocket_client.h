@@ -2,8 +2,9 @@
 
 #include <QObject>
 #include <QString>
-#include <QImage>
+#include <QSize>
 #include <memory>
+#include <atomic>
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/client.hpp>
 #include <nlohmann/json.hpp>
@@ -13,6 +14,8 @@ using json = nlohmann::json;
 
 typedef websocketpp::client<websocketpp::config::asio_tls_client> client;
 
+class FrameMailbox;
+
 /**
  * WebSocket client for server communication
  */
@@ -26,15 +29,26 @@ public:
     void connectToServer(const QString& url, const QString& sessionId);
     void disconnect();
     
-    void sendTouchCommand(const QString& action, float x, float y, int duration = 0);
+    void sendTouchCommand(const QString& action, float x, float y, int duration = 0,
+                          float endX = 0, float endY = 0);
     void sendKeyCommand(const QString& action, int keycode, const QString& text = "");
     void sendSystemCommand(const QString& action);
+    
+    /**
+     * Size frames are scaled to fit (device pixels)
+     */
+    void setVideoOutputSize(const QSize& size);
+    
+    /**
+     * Newest decoded video frame; see videoFrameAvailable
+     */
+    std::shared_ptr<FrameMailbox> frameMailbox() const;
 
 signals:
     void connected();
     void disconnected();
     void errorOccurred(const QString& error);
-    void videoFrameReceived(const QImage& frame);
+    void videoFrameAvailable();
     void deviceInfoReceived(const QString& model, const QString& version);
 
 private:
@@ -47,12 +61,14 @@ private:
     void handleBinaryMessage(const std::string& message);
     
     void sendMessage(const json& msg);
+    void sendBinary(const uint8_t* data, size_t size);
     
     client wsClient_;
     connection_hdl connection_;
     QString sessionId_;
     QString jwtToken_;
     bool isConnected_;
+    std::atomic<bool> binaryControl_;  // Server accepted compact binary commands
     
     std::shared_ptr<class VideoDecoder> decoder_;
 };
@@ -19,6 +19,14 @@ MainWindow::MainWindow(QWidget *parent)
     wsClient_ = std::make_shared<WebSocketClient>();
     decoder_ = std::make_shared<VideoDecoder>();
     
+    // Decoded frames arrive already scaled to the video area; the widget
+    // takes only the newest one each time it repaints
+    connect(videoWidget_, &VideoWidget::displaySizeChanged,
+            wsClient_.get(), &WebSocketClient::setVideoOutputSize);
+    videoWidget_->setFrameMailbox(wsClient_->frameMailbox());
+    connect(wsClient_.get(), &WebSocketClient::videoFrameAvailable,
+            videoWidget_, QOverload<>::of(&VideoWidget::update));
+    
     setWindowTitle("ARCS - PC Controller");
     resize(1200, 800);
 }
@@ -87,8 +95,6 @@ void MainWindow::onConnectClicked() {
             this, &MainWindow::onConnectionClosed);
     connect(wsClient_.get(), &WebSocketClient::errorOccurred,
             this, &MainWindow::onConnectionError);
-    connect(wsClient_.get(), &WebSocketClient::videoFrameReceived,
-            this, &MainWindow::onVideoFrameReceived);
     connect(wsClient_.get(), &WebSocketClient::deviceInfoReceived,
             this, &MainWindow::onDeviceInfoReceived);
     
@@ -133,10 +139,6 @@ void MainWindow::onConnectionError(const QString& error) {
     updateConnectionStatus(false);
 }
 
-void MainWindow::onVideoFrameReceived(const QImage& frame) {
-    videoWidget_->displayFrame(frame);
-}
-
 void MainWindow::onDeviceInfoReceived(const QString& model, const QString& version) {
     QString info = QString("Device: %1 (Android %2)").arg(model, version);
     statusBar()->showMessage(info, 5000);
@@ -26,7 +26,6 @@ private slots:
     void onConnectionEstablished();
     void onConnectionClosed();
     void onConnectionError(const QString& error);
-    void onVideoFrameReceived(const QImage& frame);
     void onDeviceInfoReceived(const QString& model, const QString& version);
 
 private:
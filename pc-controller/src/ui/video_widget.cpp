@@ -1,4 +1,5 @@
 #include "video_widget.h"
+#include "../decoder/frame_buffer.h"
 #include <QPainter>
 #include <QDateTime>
 #include <QtMath>
@@ -16,41 +17,53 @@ VideoWidget::VideoWidget(QWidget *parent)
     setMinimumSize(400, 600);
 }
 
-void VideoWidget::displayFrame(const QImage& frame) {
+void VideoWidget::setFrame(const QImage& frame, const QSize& sourceSize) {
     currentFrame_ = frame;
     
+    // The decoder already scaled the image to fit; touch input still maps
+    // to the stream's own resolution
     if (!frame.isNull()) {
-        deviceWidth_ = frame.width();
-        deviceHeight_ = frame.height();
-        
-        // Scale to widget size maintaining aspect ratio
-        scaledFrame_ = frame.scaled(
-            size(),
-            Qt::KeepAspectRatio,
-            Qt::SmoothTransformation
-        );
+        QSize deviceSize = sourceSize.isValid() ? sourceSize : frame.size();
+        deviceWidth_ = deviceSize.width();
+        deviceHeight_ = deviceSize.height();
     }
     
-    update();
+    updateFrameRect();
 }
 
 void VideoWidget::clearFrame() {
+    // Discard anything still waiting so it isn't painted after the clear
+    if (mailbox_) {
+        mailbox_->take();
+    }
+    
     currentFrame_ = QImage();
-    scaledFrame_ = QImage();
+    updateFrameRect();
     update();
 }
 
+void VideoWidget::setFrameMailbox(std::shared_ptr<FrameMailbox> mailbox) {
+    mailbox_ = std::move(mailbox);
+}
+
 void VideoWidget::paintEvent(QPaintEvent* event) {
     Q_UNUSED(event);
     
+    // Pick up the newest decoded frame; older ones were skipped
+    if (mailbox_) {
+        if (DecodedFrame* decoded = mailbox_->take()) {
+            setFrame(decoded->image, decoded->sourceSize);
+        }
+    }
+    
     QPainter painter(this);
     painter.fillRect(rect(), Qt::black);
     
-    if (!scaledFrame_.isNull()) {
-        // Center the image
-        int x = (width() - scaledFrame_.width()) / 2;
-        int y = (height() - scaledFrame_.height()) / 2;
-        painter.drawImage(x, y, scaledFrame_);
+    if (!currentFrame_.isNull()) {
+        // Normally 1:1; frames decoded before a resize are stretched until
+        // the decoder catches up
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(QRectF(frameRect_), currentFrame_);
     } else {
         // Show placeholder text
         painter.setPen(Qt::white);
@@ -63,7 +76,7 @@ void VideoWidget::paintEvent(QPaintEvent* event) {
 }
 
 void VideoWidget::mousePressEvent(QMouseEvent* event) {
-    if (event->button() == Qt::LeftButton && !currentFrame_.isNull()) {
+    if (event->button() == Qt::LeftButton && !frameRect_.isEmpty()) {
         isPressed_ = true;
         pressPosition_ = event->pos();
         currentPosition_ = event->pos();
@@ -95,7 +108,7 @@ void VideoWidget::mouseReleaseEvent(QMouseEvent* event) {
             }
         } else {
             // Swipe
-            handleSwipe(deviceStart, deviceEnd);
+            handleSwipe(deviceStart, deviceEnd, duration);
         }
     }
 }
@@ -143,27 +156,18 @@ void VideoWidget::keyPressEvent(QKeyEvent* event) {
 void VideoWidget::resizeEvent(QResizeEvent* event) {
     Q_UNUSED(event);
     
-    if (!currentFrame_.isNull()) {
-        scaledFrame_ = currentFrame_.scaled(
-            size(),
-            Qt::KeepAspectRatio,
-            Qt::SmoothTransformation
-        );
-    }
+    updateFrameRect();
+    emit displaySizeChanged(size() * devicePixelRatioF());
 }
 
 QPointF VideoWidget::mapToDevice(const QPoint& widgetPos) const {
-    if (scaledFrame_.isNull()) {
+    if (frameRect_.isEmpty()) {
         return QPointF(0, 0);
     }
     
-    // Calculate scaled image position
-    int imageX = (width() - scaledFrame_.width()) / 2;
-    int imageY = (height() - scaledFrame_.height()) / 2;
-    
     // Map widget coordinates to image coordinates
-    float imageRelX = static_cast<float>(widgetPos.x() - imageX) / scaledFrame_.width();
-    float imageRelY = static_cast<float>(widgetPos.y() - imageY) / scaledFrame_.height();
+    float imageRelX = static_cast<float>(widgetPos.x() - frameRect_.x()) / frameRect_.width();
+    float imageRelY = static_cast<float>(widgetPos.y() - frameRect_.y()) / frameRect_.height();
     
     // Clamp to [0, 1]
     imageRelX = qBound(0.0f, imageRelX, 1.0f);
@@ -176,15 +180,26 @@ QPointF VideoWidget::mapToDevice(const QPoint& widgetPos) const {
     return QPointF(deviceX, deviceY);
 }
 
+void VideoWidget::updateFrameRect() {
+    if (currentFrame_.isNull()) {
+        frameRect_ = QRect();
+        return;
+    }
+    
+    // Same fit as QImage::scaled with Qt::KeepAspectRatio, centered
+    QSize frameSize = QSize(deviceWidth_, deviceHeight_).scaled(size(), Qt::KeepAspectRatio);
+    frameRect_ = QRect(
+        (width() - frameSize.width()) / 2,
+        (height() - frameSize.height()) / 2,
+        frameSize.width(),
+        frameSize.height()
+    );
+}
+
 void VideoWidget::handleTap(const QPointF& devicePos) {
     emit touchEvent("tap", devicePos.x(), devicePos.y());
 }
 
-void VideoWidget::handleSwipe(const QPointF& start, const QPointF& end) {
-    emit touchEvent(
-        "swipe",
-        start.x(),
-        start.y(),
-        qRound(end.x() - start.x()) // Pass delta as duration for swipe
-    );
+void VideoWidget::handleSwipe(const QPointF& start, const QPointF& end, int duration) {
+    emit touchEvent("swipe", start.x(), start.y(), duration, end.x(), end.y());
 }
@@ -4,9 +4,14 @@
 #include <QImage>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <memory>
+
+class FrameMailbox;
 
 /**
  * Video display widget with touch input simulation
+ * Decoder output is taken from a frame mailbox at paint time, so only
+ * the newest frame is ever drawn.
  */
 class VideoWidget : public QWidget {
     Q_OBJECT
@@ -14,12 +19,26 @@ class VideoWidget : public QWidget {
 public:
     explicit VideoWidget(QWidget *parent = nullptr);
     
-    void displayFrame(const QImage& frame);
     void clearFrame();
+    
+    /**
+     * Mailbox to take decoded frames from on each paint; call update()
+     * when it reports a new frame
+     */
+    void setFrameMailbox(std::shared_ptr<FrameMailbox> mailbox);
 
 signals:
-    void touchEvent(const QString& action, float x, float y, int duration = 0);
+    /**
+     * Touch at (x, y); swipes run from (x, y) to (endX, endY)
+     */
+    void touchEvent(const QString& action, float x, float y, int duration = 0,
+                    float endX = 0, float endY = 0);
     void keyEvent(const QString& action, int keycode, const QString& text = "");
+    
+    /**
+     * Area available for video in device pixels; the decoder scales to it
+     */
+    void displaySizeChanged(const QSize& size);
 
 protected:
     void paintEvent(QPaintEvent* event) override;
@@ -31,11 +50,20 @@ protected:
 
 private:
     QPointF mapToDevice(const QPoint& widgetPos) const;
+    void updateFrameRect();
+    
+    /**
+     * Adopt a frame taken from the mailbox
+     * @param sourceSize Stream resolution when the frame has been scaled
+     */
+    void setFrame(const QImage& frame, const QSize& sourceSize);
+    
     void handleTap(const QPointF& devicePos);
-    void handleSwipe(const QPointF& start, const QPointF& end);
+    void handleSwipe(const QPointF& start, const QPointF& end, int duration);
     
     QImage currentFrame_;
-    QImage scaledFrame_;
+    QRect frameRect_;   // Where the frame is drawn; empty with no frame
+    std::shared_ptr<FrameMailbox> mailbox_;
     
     QPoint pressPosition_;
     QPoint currentPosition_;
@@ -1,11 +1,205 @@
 #include "device_registry.h"
 #include <sqlite3.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <iostream>
+#include <cstdlib>
 
 namespace arcs {
 namespace auth {
 
-DeviceRegistry::DeviceRegistry() {
+namespace {
+
+constexpr const char* HASH_SCHEME = "pbkdf2-sha256";
+// New hashes only; each stored hash records its own count, so hashes made
+// with an older count still verify and are upgraded on the next login
+constexpr int HASH_ITERATIONS = 600000;
+constexpr size_t SALT_SIZE = 16;
+constexpr size_t HASH_SIZE = 32;
+
+std::string to_hex(const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 0x0F];
+    }
+    return out;
+}
+
+bool from_hex(const std::string& hex, std::vector<uint8_t>& out) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    
+    out.resize(hex.size() / 2);
+    for (size_t i = 0; i < out.size(); ++i) {
+        int high = nibble(hex[i * 2]);
+        int low = nibble(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return true;
+}
+
+bool derive(const std::string& secret, const uint8_t* salt, size_t salt_size,
+            int iterations, uint8_t* out, size_t out_size) {
+    return PKCS5_PBKDF2_HMAC(secret.data(), static_cast<int>(secret.size()),
+                             salt, static_cast<int>(salt_size), iterations,
+                             EVP_sha256(), static_cast<int>(out_size), out) == 1;
+}
+
+/**
+ * Hash a secret as "pbkdf2-sha256$<iterations>$<salt hex>$<hash hex>"
+ */
+std::string hash_secret(const std::string& secret) {
+    uint8_t salt[SALT_SIZE];
+    uint8_t hash[HASH_SIZE];
+    if (RAND_bytes(salt, sizeof(salt)) != 1 ||
+        !derive(secret, salt, sizeof(salt), HASH_ITERATIONS, hash, sizeof(hash))) {
+        return std::string();
+    }
+    
+    return std::string(HASH_SCHEME) + "$" + std::to_string(HASH_ITERATIONS) + "$" +
+           to_hex(salt, sizeof(salt)) + "$" + to_hex(hash, sizeof(hash));
+}
+
+/**
+ * Iteration count recorded in a stored hash (0 if unparseable)
+ */
+int hash_iterations(const std::string& stored) {
+    size_t first = stored.find('$');
+    return first == std::string::npos ? 0 : std::atoi(stored.c_str() + first + 1);
+}
+
+/**
+ * Well-formed hash no secret matches; verified against for unknown IDs
+ * so they cost the same key derivation as known ones
+ */
+const std::string& dummy_hash() {
+    static const std::string hash =
+        std::string(HASH_SCHEME) + "$" + std::to_string(HASH_ITERATIONS) + "$" +
+        std::string(SALT_SIZE * 2, '0') + "$" + std::string(HASH_SIZE * 2, '0');
+    return hash;
+}
+
+/**
+ * Check a secret against a stored hash in constant time
+ */
+bool verify_secret(const std::string& stored, const std::string& secret) {
+    size_t first = stored.find('$');
+    size_t second = first == std::string::npos ? first : stored.find('$', first + 1);
+    size_t third = second == std::string::npos ? second : stored.find('$', second + 1);
+    if (third == std::string::npos || stored.compare(0, first, HASH_SCHEME) != 0) {
+        return false;
+    }
+    
+    int iterations = std::atoi(stored.c_str() + first + 1);
+    std::vector<uint8_t> salt;
+    std::vector<uint8_t> expected;
+    if (iterations <= 0 ||
+        !from_hex(stored.substr(second + 1, third - second - 1), salt) ||
+        !from_hex(stored.substr(third + 1), expected) ||
+        expected.size() != HASH_SIZE) {
+        return false;
+    }
+    
+    uint8_t actual[HASH_SIZE];
+    if (!derive(secret, salt.data(), salt.size(), iterations, actual, sizeof(actual))) {
+        return false;
+    }
+    return CRYPTO_memcmp(actual, expected.data(), HASH_SIZE) == 0;
+}
+
+// The column keeps its original name; it holds the encoded hash
+const char* const SCHEMA_SQL =
+    "CREATE TABLE IF NOT EXISTS devices ("
+    "  device_id TEXT PRIMARY KEY,"
+    "  device_secret TEXT NOT NULL,"
+    "  device_model TEXT NOT NULL,"
+    "  registered_at INTEGER NOT NULL,"
+    "  is_active INTEGER NOT NULL"
+    ")";
+
+const char* const UPSERT_SQL =
+    "INSERT INTO devices (device_id, device_secret, device_model, registered_at, is_active) "
+    "VALUES (?1, ?2, ?3, ?4, ?5) "
+    "ON CONFLICT(device_id) DO UPDATE SET "
+    "  device_secret = excluded.device_secret,"
+    "  device_model = excluded.device_model,"
+    "  registered_at = excluded.registered_at,"
+    "  is_active = excluded.is_active";
+
+const char* const SELECT_ONE_SQL =
+    "SELECT device_id, device_secret, device_model, registered_at, is_active "
+    "FROM devices WHERE device_id = ?1";
+
+const char* const SELECT_ALL_SQL =
+    "SELECT device_id, device_secret, device_model, registered_at, is_active "
+    "FROM devices";
+
+int64_t to_millis(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        time.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point from_millis(int64_t millis) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::milliseconds(millis)));
+}
+
+std::string column_string(sqlite3_stmt* stmt, int column) {
+    const unsigned char* text = sqlite3_column_text(stmt, column);
+    int length = sqlite3_column_bytes(stmt, column);
+    return text ? std::string(reinterpret_cast<const char*>(text), static_cast<size_t>(length))
+                : std::string();
+}
+
+DeviceRegistry::DeviceEntry read_row(sqlite3_stmt* stmt) {
+    DeviceRegistry::DeviceEntry entry;
+    entry.device_id = column_string(stmt, 0);
+    entry.secret_hash = column_string(stmt, 1);
+    entry.device_model = column_string(stmt, 2);
+    entry.registered_at = from_millis(sqlite3_column_int64(stmt, 3));
+    entry.is_active = sqlite3_column_int(stmt, 4) != 0;
+    return entry;
+}
+
+} // anonymous namespace
+
+DeviceRegistry::DeviceRegistry()
+    : persistent_(false),
+      db_(nullptr),
+      stopping_(false)
+{
+    if (RAND_bytes(cache_key_.data(), static_cast<int>(cache_key_.size())) != 1) {
+        std::cerr << "Failed to seed device verification cache key" << std::endl;
+        std::abort();
+    }
+}
+
+DeviceRegistry::~DeviceRegistry() {
+    stop_writer();
+    flush_pending();
+    
+    std::lock_guard<std::mutex> db_lock(db_mutex_);
+    finalize(statements_);
+    if (db_) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
 }
 
 bool DeviceRegistry::register_device(
@@ -13,7 +207,14 @@ bool DeviceRegistry::register_device(
     const std::string& device_secret,
     const std::string& device_model)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // Derive the hash before taking the lock; it is deliberately slow
+    std::string secret_hash = hash_secret(device_secret);
+    if (secret_hash.empty()) {
+        std::cerr << "Failed to hash secret for device " << device_id << std::endl;
+        return false;
+    }
+    
+    std::lock_guard<std::shared_mutex> lock(mutex_);
     
     // Check if already registered
     if (devices_.find(device_id) != devices_.end()) {
@@ -22,12 +223,13 @@ bool DeviceRegistry::register_device(
     
     DeviceEntry entry;
     entry.device_id = device_id;
-    entry.device_secret = device_secret;
+    entry.secret_hash = std::move(secret_hash);
     entry.device_model = device_model;
     entry.registered_at = std::chrono::system_clock::now();
     entry.is_active = true;
     
     devices_[device_id] = entry;
+    mark_dirty(device_id);
     return true;
 }
 
@@ -35,49 +237,474 @@ bool DeviceRegistry::authenticate(
     const std::string& device_id,
     const std::string& device_secret)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::string secret_hash;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        
+        auto it = devices_.find(device_id);
+        if (it != devices_.end() && it->second.is_active) {
+            secret_hash = it->second.secret_hash;
+        }
+    }
     
-    auto it = devices_.find(device_id);
-    if (it == devices_.end()) {
+    // Unknown and inactive IDs run the same derivation, so response time
+    // does not reveal which IDs exist
+    if (secret_hash.empty()) {
+        verify_secret(dummy_hash(), device_secret);
         return false;
     }
     
-    const auto& entry = it->second;
-    return entry.is_active && entry.device_secret == device_secret;
+    SecretDigest digest = digest_secret(device_secret);
+    if (check_verified(device_id, digest)) {
+        return true;
+    }
+    
+    // Key derivation runs outside the registry lock
+    if (!verify_secret(secret_hash, device_secret)) {
+        return false;
+    }
+    
+    remember_verified(device_id, digest);
+    
+    if (hash_iterations(secret_hash) < HASH_ITERATIONS) {
+        upgrade_hash(device_id, secret_hash, device_secret);
+    }
+    return true;
+}
+
+void DeviceRegistry::upgrade_hash(
+    const std::string& device_id,
+    const std::string& old_hash,
+    const std::string& device_secret)
+{
+    std::string new_hash = hash_secret(device_secret);
+    if (new_hash.empty()) {
+        return;
+    }
+    
+    std::lock_guard<std::shared_mutex> lock(mutex_);
+    
+    // Skip if the secret was changed meanwhile
+    auto it = devices_.find(device_id);
+    if (it != devices_.end() && it->second.secret_hash == old_hash) {
+        it->second.secret_hash = std::move(new_hash);
+        mark_dirty(device_id);
+    }
 }
 
 std::optional<DeviceRegistry::DeviceEntry> DeviceRegistry::get_device(
     const std::string& device_id)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        
+        auto it = devices_.find(device_id);
+        if (it != devices_.end()) {
+            return it->second;
+        }
+    }
     
-    auto it = devices_.find(device_id);
-    if (it != devices_.end()) {
-        return it->second;
+    if (check_missing(device_id)) {
+        return std::nullopt;
+    }
+    
+    // Read-through: the row may have been added by another process
+    std::lock_guard<std::mutex> db_lock(db_mutex_);
+    if (!db_) {
+        return std::nullopt;
+    }
+    
+    sqlite3_stmt* stmt = statements_.select_one;
+    sqlite3_bind_text(stmt, 1, device_id.data(), static_cast<int>(device_id.size()), SQLITE_STATIC);
+    
+    std::optional<DeviceEntry> result;
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        result = read_row(stmt);
+    } else if (rc != SQLITE_DONE) {
+        std::cerr << "Device lookup failed: " << sqlite3_errmsg(db_) << std::endl;
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    
+    if (result) {
+        std::lock_guard<std::shared_mutex> lock(mutex_);
+        // A concurrent registration wins over the stored row
+        return devices_.try_emplace(device_id, std::move(*result)).first->second;
+    }
+    if (rc == SQLITE_DONE) {
+        remember_missing(device_id);
     }
     return std::nullopt;
 }
 
 bool DeviceRegistry::deactivate_device(const std::string& device_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::shared_mutex> lock(mutex_);
     
     auto it = devices_.find(device_id);
     if (it != devices_.end()) {
         it->second.is_active = false;
+        mark_dirty(device_id);
+        forget_verified(device_id);
         return true;
     }
     return false;
 }
 
 bool DeviceRegistry::load_from_db(const std::string& db_path) {
-    // TODO: Implement SQLite loading
+    std::lock_guard<std::mutex> db_lock(db_mutex_);
+    
+    if (db_) {
+        std::cerr << "Device database already open: " << db_path_ << std::endl;
+        return false;
+    }
+    
+    sqlite3* db = open_db(db_path);
+    if (!db) {
+        return false;
+    }
+    
+    Statements statements;
+    if (!prepare(db, statements)) {
+        sqlite3_close(db);
+        return false;
+    }
+    
+    // Bulk load with a single scan, sized up front
+    std::vector<DeviceEntry> loaded;
+    sqlite3_stmt* count_stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM devices", -1, &count_stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(count_stmt) == SQLITE_ROW) {
+        loaded.reserve(static_cast<size_t>(sqlite3_column_int64(count_stmt, 0)));
+    }
+    sqlite3_finalize(count_stmt);
+    
+    sqlite3_stmt* select_all = nullptr;
+    bool ok = sqlite3_prepare_v2(db, SELECT_ALL_SQL, -1, &select_all, nullptr) == SQLITE_OK;
+    int rc = SQLITE_DONE;
+    while (ok && (rc = sqlite3_step(select_all)) == SQLITE_ROW) {
+        loaded.push_back(read_row(select_all));
+    }
+    sqlite3_finalize(select_all);
+    
+    if (!ok || rc != SQLITE_DONE) {
+        std::cerr << "Failed to load devices: " << sqlite3_errmsg(db) << std::endl;
+        finalize(statements);
+        sqlite3_close(db);
+        return false;
+    }
+    
+    {
+        std::lock_guard<std::shared_mutex> lock(mutex_);
+        
+        // Devices registered before the database was opened still need writing
+        for (const auto& pair : devices_) {
+            dirty_.insert(pair.first);
+        }
+        persistent_ = true;
+        
+        devices_.reserve(devices_.size() + loaded.size());
+        for (auto& entry : loaded) {
+            std::string device_id = entry.device_id;
+            devices_.try_emplace(std::move(device_id), std::move(entry));
+        }
+    }
+    
+    db_ = db;
+    db_path_ = db_path;
+    statements_ = statements;
+    
+    std::cout << "Loaded " << loaded.size() << " devices from " << db_path << std::endl;
+    
+    writer_ = std::thread(&DeviceRegistry::writer_loop, this);
     return true;
 }
 
 bool DeviceRegistry::save_to_db(const std::string& db_path) {
-    // TODO: Implement SQLite saving
+    bool open_db_path;
+    {
+        std::lock_guard<std::mutex> db_lock(db_mutex_);
+        open_db_path = db_ && db_path == db_path_;
+    }
+    if (open_db_path) {
+        return flush_pending();
+    }
+    
+    // Export a full snapshot through a separate connection
+    sqlite3* db = open_db(db_path);
+    if (!db) {
+        return false;
+    }
+    
+    std::vector<DeviceEntry> snapshot;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        snapshot.reserve(devices_.size());
+        for (const auto& pair : devices_) {
+            snapshot.push_back(pair.second);
+        }
+    }
+    
+    Statements statements;
+    bool ok = prepare(db, statements) && write_entries(db, statements.upsert, snapshot);
+    finalize(statements);
+    sqlite3_close(db);
+    return ok;
+}
+
+sqlite3* DeviceRegistry::open_db(const std::string& db_path) {
+    sqlite3* db = nullptr;
+    int rc = sqlite3_open_v2(db_path.c_str(), &db,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+                             nullptr);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Failed to open device database " << db_path << ": "
+                  << (db ? sqlite3_errmsg(db) : sqlite3_errstr(rc)) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+    
+    sqlite3_busy_timeout(db, 5000);
+    
+    // WAL lets readers (and the read-through path) proceed during batch commits
+    if (!exec(db, "PRAGMA journal_mode=WAL") ||
+        !exec(db, "PRAGMA synchronous=NORMAL") ||
+        !exec(db, SCHEMA_SQL)) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    
+    return db;
+}
+
+bool DeviceRegistry::exec(sqlite3* db, const char* sql) {
+    char* error = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::cerr << "SQLite error: " << (error ? error : "unknown") << std::endl;
+        sqlite3_free(error);
+        return false;
+    }
     return true;
 }
 
+bool DeviceRegistry::prepare(sqlite3* db, Statements& statements) {
+    if (sqlite3_prepare_v3(db, UPSERT_SQL, -1, SQLITE_PREPARE_PERSISTENT,
+                           &statements.upsert, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v3(db, SELECT_ONE_SQL, -1, SQLITE_PREPARE_PERSISTENT,
+                           &statements.select_one, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to prepare device statements: " << sqlite3_errmsg(db) << std::endl;
+        finalize(statements);
+        return false;
+    }
+    return true;
+}
+
+void DeviceRegistry::finalize(Statements& statements) {
+    sqlite3_finalize(statements.upsert);
+    sqlite3_finalize(statements.select_one);
+    statements = Statements();
+}
+
+bool DeviceRegistry::write_entries(
+    sqlite3* db,
+    sqlite3_stmt* upsert,
+    const std::vector<DeviceEntry>& entries)
+{
+    if (!exec(db, "BEGIN IMMEDIATE")) {
+        return false;
+    }
+    
+    for (const auto& entry : entries) {
+        sqlite3_bind_text(upsert, 1, entry.device_id.data(),
+                          static_cast<int>(entry.device_id.size()), SQLITE_STATIC);
+        sqlite3_bind_text(upsert, 2, entry.secret_hash.data(),
+                          static_cast<int>(entry.secret_hash.size()), SQLITE_STATIC);
+        sqlite3_bind_text(upsert, 3, entry.device_model.data(),
+                          static_cast<int>(entry.device_model.size()), SQLITE_STATIC);
+        sqlite3_bind_int64(upsert, 4, to_millis(entry.registered_at));
+        sqlite3_bind_int(upsert, 5, entry.is_active ? 1 : 0);
+        
+        int rc = sqlite3_step(upsert);
+        sqlite3_reset(upsert);
+        sqlite3_clear_bindings(upsert);
+        
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Failed to write device " << entry.device_id << ": "
+                      << sqlite3_errmsg(db) << std::endl;
+            exec(db, "ROLLBACK");
+            return false;
+        }
+    }
+    
+    if (!exec(db, "COMMIT")) {
+        exec(db, "ROLLBACK");
+        return false;
+    }
+    return true;
+}
+
+DeviceRegistry::SecretDigest DeviceRegistry::digest_secret(
+    const std::string& device_secret) const
+{
+    SecretDigest digest{};
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), cache_key_.data(), static_cast<int>(cache_key_.size()),
+         reinterpret_cast<const unsigned char*>(device_secret.data()), device_secret.size(),
+         digest.data(), &length);
+    return digest;
+}
+
+bool DeviceRegistry::check_verified(const std::string& device_id, const SecretDigest& digest) {
+    std::lock_guard<std::mutex> lock(verified_mutex_);
+    
+    auto it = verified_.find(device_id);
+    if (it == verified_.end()) {
+        return false;
+    }
+    
+    if (it->second.expires_at <= std::chrono::steady_clock::now()) {
+        verified_.erase(it);
+        return false;
+    }
+    return CRYPTO_memcmp(it->second.digest.data(), digest.data(), digest.size()) == 0;
+}
+
+void DeviceRegistry::remember_verified(const std::string& device_id, const SecretDigest& digest) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(verified_mutex_);
+    
+    if (verified_.size() >= VERIFIED_CACHE_CAPACITY) {
+        for (auto it = verified_.begin(); it != verified_.end();) {
+            if (it->second.expires_at <= now) {
+                it = verified_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (verified_.size() >= VERIFIED_CACHE_CAPACITY) {
+            return;
+        }
+    }
+    
+    verified_[device_id] = VerifiedCredential{digest, now + VERIFIED_TTL};
+}
+
+void DeviceRegistry::forget_verified(const std::string& device_id) {
+    std::lock_guard<std::mutex> lock(verified_mutex_);
+    verified_.erase(device_id);
+}
+
+bool DeviceRegistry::check_missing(const std::string& device_id) {
+    std::lock_guard<std::mutex> lock(missing_mutex_);
+    
+    auto it = missing_.find(device_id);
+    if (it == missing_.end()) {
+        return false;
+    }
+    
+    if (it->second <= std::chrono::steady_clock::now()) {
+        missing_.erase(it);
+        return false;
+    }
+    return true;
+}
+
+void DeviceRegistry::remember_missing(const std::string& device_id) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(missing_mutex_);
+    
+    if (missing_.size() >= MISSING_CACHE_CAPACITY) {
+        for (auto it = missing_.begin(); it != missing_.end();) {
+            if (it->second <= now) {
+                it = missing_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (missing_.size() >= MISSING_CACHE_CAPACITY) {
+            return;
+        }
+    }
+    
+    missing_[device_id] = now + MISSING_TTL;
+}
+
+void DeviceRegistry::mark_dirty(const std::string& device_id) {
+    // Caller holds mutex_
+    if (!persistent_) {
+        return;
+    }
+    
+    dirty_.insert(device_id);
+    if (dirty_.size() >= WRITE_BATCH_SIZE) {
+        writer_cv_.notify_one();
+    }
+}
+
+bool DeviceRegistry::flush_pending() {
+    // Holding db_mutex_ across snapshot and write keeps batches in order
+    std::lock_guard<std::mutex> db_lock(db_mutex_);
+    if (!db_) {
+        return true;
+    }
+    
+    std::vector<DeviceEntry> entries;
+    {
+        std::lock_guard<std::shared_mutex> lock(mutex_);
+        entries.reserve(dirty_.size());
+        for (const auto& device_id : dirty_) {
+            auto it = devices_.find(device_id);
+            if (it != devices_.end()) {
+                entries.push_back(it->second);
+            }
+        }
+        dirty_.clear();
+    }
+    
+    if (entries.empty()) {
+        return true;
+    }
+    
+    if (!write_entries(db_, statements_.upsert, entries)) {
+        // Keep the changes for the next attempt
+        std::lock_guard<std::shared_mutex> lock(mutex_);
+        for (const auto& entry : entries) {
+            dirty_.insert(entry.device_id);
+        }
+        return false;
+    }
+    return true;
+}
+
+void DeviceRegistry::writer_loop() {
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            writer_cv_.wait_for(lock, WRITE_INTERVAL, [this]() {
+                return stopping_ || dirty_.size() >= WRITE_BATCH_SIZE;
+            });
+            stopping = stopping_;
+        }
+        
+        if (stopping) {
+            break;
+        }
+        flush_pending();
+    }
+}
+
+void DeviceRegistry::stop_writer() {
+    {
+        std::lock_guard<std::shared_mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    writer_cv_.notify_one();
+    
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
 } // namespace auth
 } // namespace arcs
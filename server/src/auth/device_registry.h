@@ -2,27 +2,45 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <array>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
 #include <optional>
 
+struct sqlite3;
+struct sqlite3_stmt;
+
 namespace arcs {
 namespace auth {
 
 /**
  * Device registry
- * Stores and validates device credentials
+ * Stores and validates device credentials. Secrets are kept only as
+ * salted PBKDF2 hashes. All lookups are served from
+ * memory; once load_from_db has opened a database, changes are written
+ * back to it by a background thread in batched transactions.
  */
 class DeviceRegistry {
 public:
     struct DeviceEntry {
         std::string device_id;
-        std::string device_secret;
+        std::string secret_hash;    // "pbkdf2-sha256$<iterations>$<salt>$<hash>"
         std::string device_model;
         std::chrono::system_clock::time_point registered_at;
         bool is_active;
     };
     
     DeviceRegistry();
+    ~DeviceRegistry();
+    
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
     
     /**
      * Register new device
@@ -33,12 +51,17 @@ public:
     
     /**
      * Authenticate device
+     * Memory only; never touches the database. Successful verifications
+     * are cached briefly so reconnect storms skip the key derivation.
      */
     bool authenticate(const std::string& device_id,
                      const std::string& device_secret);
     
     /**
      * Get device info
+     * Falls back to the database for devices not yet in memory; IDs
+     * the database does not know are remembered briefly so repeated
+     * unknown lookups stay off the database lock
      */
     std::optional<DeviceEntry> get_device(const std::string& device_id);
     
@@ -49,17 +72,96 @@ public:
     
     /**
      * Load from database
+     * Opens (or creates) the database in WAL mode, bulk loads every device
+     * and keeps the database open for write-behind
      */
     bool load_from_db(const std::string& db_path);
     
     /**
      * Save to database
+     * For the open database, writes pending changes now; any other path
+     * receives a full snapshot
      */
     bool save_to_db(const std::string& db_path);
 
 private:
+    /**
+     * Cached prepared statements for the open database
+     */
+    struct Statements {
+        sqlite3_stmt* upsert = nullptr;
+        sqlite3_stmt* select_one = nullptr;
+    };
+    
+    using SecretDigest = std::array<uint8_t, 32>;
+    
+    /**
+     * Recently verified credential
+     */
+    struct VerifiedCredential {
+        SecretDigest digest;    // Keyed digest of the secret that verified
+        std::chrono::steady_clock::time_point expires_at;
+    };
+    
+    static constexpr size_t WRITE_BATCH_SIZE = 256;
+    static constexpr std::chrono::milliseconds WRITE_INTERVAL{200};
+    static constexpr std::chrono::seconds VERIFIED_TTL{60};
+    static constexpr size_t VERIFIED_CACHE_CAPACITY = 100000;
+    static constexpr std::chrono::seconds MISSING_TTL{5};
+    static constexpr size_t MISSING_CACHE_CAPACITY = 100000;
+    
+    static sqlite3* open_db(const std::string& db_path);
+    static bool exec(sqlite3* db, const char* sql);
+    static bool prepare(sqlite3* db, Statements& statements);
+    static void finalize(Statements& statements);
+    static bool write_entries(sqlite3* db, sqlite3_stmt* upsert,
+                              const std::vector<DeviceEntry>& entries);
+    
+    SecretDigest digest_secret(const std::string& device_secret) const;
+    bool check_verified(const std::string& device_id, const SecretDigest& digest);
+    void remember_verified(const std::string& device_id, const SecretDigest& digest);
+    void forget_verified(const std::string& device_id);
+    
+    /**
+     * Rehash a verified secret stored with fewer than the current iterations
+     */
+    void upgrade_hash(const std::string& device_id,
+                      const std::string& old_hash,
+                      const std::string& device_secret);
+    
+    bool check_missing(const std::string& device_id);
+    void remember_missing(const std::string& device_id);
+    
+    void mark_dirty(const std::string& device_id);
+    bool flush_pending();
+    void writer_loop();
+    void stop_writer();
+    
     std::unordered_map<std::string, DeviceEntry> devices_;
-    std::mutex mutex_;
+    std::unordered_set<std::string> dirty_;  // Awaiting write-behind
+    bool persistent_;                        // Set once a database is open
+    std::shared_mutex mutex_;
+    
+    // Verification cache; cache_key_ is random per process so cached
+    // digests are useless outside it
+    std::array<uint8_t, 32> cache_key_;
+    std::unordered_map<std::string, VerifiedCredential> verified_;
+    std::mutex verified_mutex_;
+    
+    // IDs recently found in neither memory nor the database
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> missing_;
+    std::mutex missing_mutex_;
+    
+    // Database state; db_mutex_ is always taken before mutex_
+    sqlite3* db_;
+    std::string db_path_;
+    Statements statements_;
+    std::mutex db_mutex_;
+    
+    // Write-behind thread
+    std::condition_variable_any writer_cv_;
+    bool stopping_;
+    std::thread writer_;
 };
 
 } // namespace auth
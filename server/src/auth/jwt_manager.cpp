@@ -1,14 +1,30 @@
 #include "jwt_manager.h"
 #include <jwt-cpp/jwt.h>
+#include <openssl/sha.h>
 #include <iostream>
 
 namespace arcs {
 namespace auth {
 
+struct JWTManager::Verifier {
+    explicit Verifier(const std::string& secret)
+        : verifier(jwt::verify()
+              .allow_algorithm(jwt::algorithm::hs256{secret})
+              .with_issuer("arcs-server")) {
+    }
+    
+    decltype(jwt::verify()) verifier;
+};
+
 JWTManager::JWTManager(const std::string& secret, int expiry_hours)
-    : secret_(secret), expiry_hours_(expiry_hours) {
+    : secret_(secret),
+      expiry_hours_(expiry_hours),
+      verifier_(std::make_unique<Verifier>(secret)),
+      revoked_(std::make_shared<const RevocationSet>()) {
 }
 
+JWTManager::~JWTManager() = default;
+
 std::string JWTManager::generate_token(
     const std::string& device_id,
     const std::string& session_id,
@@ -35,17 +51,23 @@ std::optional<JWTManager::TokenPayload> JWTManager::validate_token(
 {
     try {
         // Check if revoked
-        if (is_revoked(token)) {
+        TokenDigest digest = digest_of(token);
+        if (is_revoked(digest)) {
             return std::nullopt;
         }
         
-        // Verify token
-        auto verifier = jwt::verify()
-            .allow_algorithm(jwt::algorithm::hs256{secret_})
-            .with_issuer("arcs-server");
+        // Repeat presentations of a verified token skip HMAC verification
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex_);
+            auto cached = cache_lookup(digest);
+            if (cached) {
+                return cached;
+            }
+        }
         
+        // Verify token
         auto decoded = jwt::decode(token);
-        verifier.verify(decoded);
+        verifier_->verifier.verify(decoded);
         
         // Extract payload
         TokenPayload payload;
@@ -59,6 +81,11 @@ std::optional<JWTManager::TokenPayload> JWTManager::validate_token(
             return std::nullopt;
         }
         
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex_);
+            cache_insert(digest, payload);
+        }
+        
         return payload;
         
     } catch (const std::exception& e) {
@@ -77,13 +104,95 @@ bool JWTManager::is_expired(const std::string& token) {
 }
 
 void JWTManager::revoke_token(const std::string& token) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    revoked_tokens_.insert(token);
+    TokenDigest digest = digest_of(token);
+    
+    // Revocation only matters while the token could still validate
+    auto now = std::chrono::system_clock::now();
+    auto expires_at = now + std::chrono::hours(expiry_hours_);
+    try {
+        expires_at = jwt::decode(token).get_expires_at();
+    } catch (...) {
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(revocation_write_mutex_);
+        
+        auto next = std::make_shared<RevocationSet>();
+        auto current = std::atomic_load(&revoked_);
+        next->reserve(current->size() + 1);
+        for (const auto& [revoked_digest, revoked_expiry] : *current) {
+            if (revoked_expiry > now) {
+                next->emplace(revoked_digest, revoked_expiry);
+            }
+        }
+        if (expires_at > now) {
+            (*next)[digest] = expires_at;
+        }
+        
+        std::atomic_store(&revoked_, std::shared_ptr<const RevocationSet>(std::move(next)));
+    }
+    
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_erase(digest);
 }
 
 bool JWTManager::is_revoked(const std::string& token) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return revoked_tokens_.find(token) != revoked_tokens_.end();
+    return is_revoked(digest_of(token));
+}
+
+bool JWTManager::is_revoked(const TokenDigest& digest) const {
+    auto snapshot = std::atomic_load(&revoked_);
+    
+    auto it = snapshot->find(digest);
+    return it != snapshot->end() && it->second > std::chrono::system_clock::now();
+}
+
+JWTManager::TokenDigest JWTManager::digest_of(const std::string& token) {
+    TokenDigest digest;
+    SHA256(reinterpret_cast<const unsigned char*>(token.data()), token.size(), digest.data());
+    return digest;
+}
+
+std::optional<JWTManager::TokenPayload> JWTManager::cache_lookup(const TokenDigest& digest) {
+    auto it = cache_index_.find(digest);
+    if (it == cache_index_.end()) {
+        return std::nullopt;
+    }
+    
+    // Entries live until the token's own expiry
+    if (std::chrono::system_clock::now() > it->second->payload.expires_at) {
+        cache_lru_.erase(it->second);
+        cache_index_.erase(it);
+        return std::nullopt;
+    }
+    
+    cache_lru_.splice(cache_lru_.begin(), cache_lru_, it->second);
+    return it->second->payload;
+}
+
+void JWTManager::cache_insert(const TokenDigest& digest, const TokenPayload& payload) {
+    auto it = cache_index_.find(digest);
+    if (it != cache_index_.end()) {
+        it->second->payload = payload;
+        cache_lru_.splice(cache_lru_.begin(), cache_lru_, it->second);
+        return;
+    }
+    
+    if (cache_lru_.size() >= TOKEN_CACHE_CAPACITY) {
+        cache_index_.erase(cache_lru_.back().digest);
+        cache_lru_.pop_back();
+    }
+    
+    cache_lru_.push_front(CacheEntry{digest, payload});
+    cache_index_[digest] = cache_lru_.begin();
+}
+
+void JWTManager::cache_erase(const TokenDigest& digest) {
+    auto it = cache_index_.find(digest);
+    if (it != cache_index_.end()) {
+        cache_lru_.erase(it->second);
+        cache_index_.erase(it);
+    }
 }
 
 } // namespace auth
@@ -1,9 +1,16 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <array>
+#include <list>
 #include <chrono>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
+#include <atomic>
+#include <cstring>
 
 namespace arcs {
 namespace auth {
@@ -28,6 +35,7 @@ public:
      * @param expiry_hours Token validity in hours
      */
     explicit JWTManager(const std::string& secret, int expiry_hours = 24);
+    ~JWTManager();
     
     /**
      * Generate JWT token
@@ -49,6 +57,7 @@ public:
     
     /**
      * Revoke token (add to blacklist)
+     * Entry is kept only until the token's own expiry
      */
     void revoke_token(const std::string& token);
     
@@ -58,10 +67,56 @@ public:
     bool is_revoked(const std::string& token);
 
 private:
+    /**
+     * SHA-256 of a token; identifies it without keeping the token itself
+     */
+    using TokenDigest = std::array<uint8_t, 32>;
+    
+    struct TokenDigestHash {
+        size_t operator()(const TokenDigest& digest) const {
+            size_t h;
+            std::memcpy(&h, digest.data(), sizeof(h));
+            return h;
+        }
+    };
+    
+    struct CacheEntry {
+        TokenDigest digest;
+        TokenPayload payload;
+    };
+    
+    static TokenDigest digest_of(const std::string& token);
+    
+    /**
+     * Revoked token digests mapped to token expiry. Published as an
+     * immutable snapshot: readers load it without locking, writers copy,
+     * prune expired entries and swap.
+     */
+    using RevocationSet = std::unordered_map<
+        TokenDigest, std::chrono::system_clock::time_point, TokenDigestHash>;
+    
+    bool is_revoked(const TokenDigest& digest) const;
+    
+    /**
+     * Validated-token LRU (caller holds cache_mutex_)
+     */
+    std::optional<TokenPayload> cache_lookup(const TokenDigest& digest);
+    void cache_insert(const TokenDigest& digest, const TokenPayload& payload);
+    void cache_erase(const TokenDigest& digest);
+    
+    struct Verifier;
+    
     std::string secret_;
     int expiry_hours_;
-    std::unordered_set<std::string> revoked_tokens_;
-    std::mutex mutex_;
+    std::unique_ptr<Verifier> verifier_;  // Built once, reused per token
+    std::shared_ptr<const RevocationSet> revoked_;
+    std::mutex revocation_write_mutex_;
+    
+    std::list<CacheEntry> cache_lru_;  // Most recently used first
+    std::unordered_map<TokenDigest, std::list<CacheEntry>::iterator, TokenDigestHash> cache_index_;
+    std::mutex cache_mutex_;
+    
+    static constexpr size_t TOKEN_CACHE_CAPACITY = 4096;
 };
 
 } // namespace auth
@@ -1,20 +1,46 @@
 #include "audit_logger.h"
+#include "audit_segment.h"
 #include <iostream>
-#include <iomanip>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
 
 namespace arcs {
 namespace logger {
 
-AuditLogger::AuditLogger(const std::string& log_file) {
-    log_file_.open(log_file, std::ios::app);
-    if (!log_file_.is_open()) {
-        std::cerr << "Failed to open audit log: " << log_file << std::endl;
+AuditLogger::AuditLogger(const std::string& log_file)
+    : AuditLogger(log_file, Options{8192, 512, std::chrono::milliseconds(200), false,
+                                Format::TEXT, 64 * 1024 * 1024}) {
+}
+
+AuditLogger::AuditLogger(const std::string& log_file, const Options& options)
+    : options_(options),
+      queue_(options.queue_capacity),
+      dropped_(0),
+      timestamp_cache_{-1, {}, 0},
+      flush_requested_(0),
+      flush_completed_(0),
+      stopping_(false)
+{
+    if (options_.format == Format::BINARY) {
+        segment_writer_ = std::make_unique<AuditSegmentWriter>(log_file, options_.segment_size);
+    } else {
+        log_file_.open(log_file, std::ios::app);
+        if (!log_file_.is_open()) {
+            std::cerr << "Failed to open audit log: " << log_file << std::endl;
+        }
     }
+    
+    writer_ = std::thread(&AuditLogger::writer_loop, this);
 }
 
 AuditLogger::~AuditLogger() {
-    flush();
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        stopping_ = true;
+    }
+    writer_cv_.notify_one();
+    writer_.join();
+    
     if (log_file_.is_open()) {
         log_file_.close();
     }
@@ -27,28 +53,34 @@ void AuditLogger::log(
     const std::string& message,
     const std::string& details)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    enqueue(event_type, level, user_id, "", message, details);
+}
+
+void AuditLogger::enqueue(
+    EventType event_type,
+    LogLevel level,
+    const std::string& user_id,
+    const std::string& session_id,
+    const std::string& message,
+    const std::string& details)
+{
+    Record record;
+    record.timestamp = std::chrono::system_clock::now();
+    record.event_type = event_type;
+    record.level = level;
+    copy_field(record.user_id, sizeof(record.user_id), user_id);
+    copy_field(record.session_id, sizeof(record.session_id), session_id);
+    copy_field(record.message, sizeof(record.message), message);
+    copy_field(record.details, sizeof(record.details), details);
     
-    if (!log_file_.is_open()) {
+    if (!queue_.try_push(record)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
         return;
     }
     
-    std::string log_entry = 
-        get_timestamp() + " | " +
-        log_level_to_string(level) + " | " +
-        event_type_to_string(event_type) + " | " +
-        "user=" + user_id + " | " +
-        message;
-    
-    if (!details.empty()) {
-        log_entry += " | " + details;
-    }
-    
-    log_file_ << log_entry << std::endl;
-    
-    // Also print to console for critical events
-    if (level == LogLevel::CRITICAL || level == LogLevel::ERROR) {
-        std::cout << log_entry << std::endl;
+    // Wake the writer early once a full batch is waiting
+    if (queue_.size_approx() >= options_.flush_batch) {
+        writer_cv_.notify_one();
     }
 }
 
@@ -71,10 +103,11 @@ void AuditLogger::log_session(
     const std::string& device_id,
     bool start)
 {
-    log(
+    enqueue(
         start ? EventType::SESSION_START : EventType::SESSION_END,
         LogLevel::INFO,
         device_id,
+        session_id,
         start ? "Session started" : "Session ended",
         "session_id=" + session_id
     );
@@ -84,23 +117,155 @@ void AuditLogger::log_command(
     const std::string& session_id,
     const std::string& command_type)
 {
-    log(
+    enqueue(
         EventType::COMMAND_RECEIVED,
         LogLevel::INFO,
         session_id,
+        session_id,
         "Command: " + command_type,
         ""
     );
 }
 
 void AuditLogger::flush() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (log_file_.is_open()) {
-        log_file_.flush();
+    std::unique_lock<std::mutex> lock(writer_mutex_);
+    uint64_t ticket = ++flush_requested_;
+    writer_cv_.notify_one();
+    flushed_cv_.wait(lock, [&]() { return flush_completed_ >= ticket || stopping_; });
+}
+
+size_t AuditLogger::get_dropped_count() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+void AuditLogger::copy_field(char* dest, size_t dest_size, const std::string& src) {
+    size_t len = std::min(src.size(), dest_size - 1);
+    std::memcpy(dest, src.data(), len);
+    dest[len] = '\0';
+}
+
+void AuditLogger::writer_loop() {
+    std::string batch;
+    Record record;
+    size_t reported_dropped = 0;
+    
+    for (;;) {
+        uint64_t flush_ticket;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(writer_mutex_);
+            writer_cv_.wait_for(lock, options_.flush_interval, [&]() {
+                return stopping_ || flush_requested_ > flush_completed_ ||
+                       queue_.size_approx() >= options_.flush_batch;
+            });
+            flush_ticket = flush_requested_;
+            stopping = stopping_;
+        }
+        
+        // Drain everything queued so far and write it in one call
+        batch.clear();
+        bool wrote = false;
+        while (queue_.try_pop(record)) {
+            if (!write_record(record, batch)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+            wrote = true;
+        }
+        
+        size_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            Record overflow;
+            overflow.timestamp = std::chrono::system_clock::now();
+            overflow.event_type = EventType::SUSPICIOUS_ACTIVITY;
+            overflow.level = LogLevel::WARNING;
+            copy_field(overflow.user_id, sizeof(overflow.user_id), "audit");
+            overflow.session_id[0] = '\0';
+            copy_field(overflow.message, sizeof(overflow.message),
+                       "Audit log overflow, " + std::to_string(dropped - reported_dropped) +
+                       " records dropped");
+            overflow.details[0] = '\0';
+            // Not counted if it fails itself; the next pass reports again
+            if (write_record(overflow, batch)) {
+                reported_dropped = dropped;
+            }
+            wrote = true;
+        }
+        
+        if (log_file_.is_open() && !batch.empty()) {
+            log_file_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            log_file_.flush();
+        }
+        if (segment_writer_ && wrote) {
+            segment_writer_->sync();
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(writer_mutex_);
+            flush_completed_ = flush_ticket;
+        }
+        flushed_cv_.notify_all();
+        
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+bool AuditLogger::write_record(const Record& record, std::string& out) {
+    bool echo = record.level == LogLevel::CRITICAL || record.level == LogLevel::ERROR;
+    
+    if (!segment_writer_) {
+        size_t line_start = out.size();
+        format_record(record, out);
+        
+        // Also print to console for critical events
+        if (echo) {
+            std::cout.write(out.data() + line_start,
+                            static_cast<std::streamsize>(out.size() - line_start));
+        }
+        return true;
+    }
+    
+    int64_t timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        record.timestamp.time_since_epoch()).count();
+    bool stored = segment_writer_->append(
+        timestamp_ms,
+        event_type_to_string(record.event_type),
+        static_cast<uint8_t>(record.level),
+        record.user_id,
+        record.session_id,
+        record.message,
+        record.details
+    );
+    
+    if (echo) {
+        std::string line;
+        format_record(record, line);
+        std::cout << line;
+    }
+    return stored;
+}
+
+void AuditLogger::format_record(const Record& record, std::string& out) {
+    append_timestamp(record.timestamp, out);
+    out += " | ";
+    out += log_level_to_string(record.level);
+    out += " | ";
+    out += event_type_to_string(record.event_type);
+    out += " | user=";
+    out += record.user_id;
+    out += " | ";
+    out += record.message;
+    
+    if (record.details[0] != '\0') {
+        out += " | ";
+        out += record.details;
     }
+    
+    out += '\n';
 }
 
-std::string AuditLogger::event_type_to_string(EventType type) {
+const char* AuditLogger::event_type_to_string(EventType type) {
     switch (type) {
         case EventType::AUTH_SUCCESS: return "AUTH_SUCCESS";
         case EventType::AUTH_FAILURE: return "AUTH_FAILURE";
@@ -115,7 +280,7 @@ std::string AuditLogger::event_type_to_string(EventType type) {
     }
 }
 
-std::string AuditLogger::log_level_to_string(LogLevel level) {
+const char* AuditLogger::log_level_to_string(LogLevel level) {
     switch (level) {
         case LogLevel::INFO: return "INFO";
         case LogLevel::WARNING: return "WARN";
@@ -125,13 +290,44 @@ std::string AuditLogger::log_level_to_string(LogLevel level) {
     }
 }
 
-std::string AuditLogger::get_timestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
+void AuditLogger::append_timestamp(
+    std::chrono::system_clock::time_point time,
+    std::string& out)
+{
+    auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+        time.time_since_epoch()).count();
+    std::time_t second = static_cast<std::time_t>(since_epoch / 1000);
+    int millis = static_cast<int>(since_epoch % 1000);
+    if (millis < 0) {
+        second -= 1;
+        millis += 1000;
+    }
+    
+    if (second != timestamp_cache_.second) {
+        std::tm tm;
+        if (options_.utc_timestamps) {
+            gmtime_r(&second, &tm);
+        } else {
+            localtime_r(&second, &tm);
+        }
+        
+        const char* format = options_.utc_timestamps ? "%Y-%m-%dT%H:%M:%S" : "%Y-%m-%d %H:%M:%S";
+        timestamp_cache_.length = std::strftime(
+            timestamp_cache_.prefix, sizeof(timestamp_cache_.prefix), format, &tm);
+        timestamp_cache_.second = second;
+    }
+    
+    char suffix[6] = {
+        '.',
+        static_cast<char>('0' + millis / 100),
+        static_cast<char>('0' + millis / 10 % 10),
+        static_cast<char>('0' + millis % 10),
+        'Z',
+        '\0'
+    };
     
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+    out.append(timestamp_cache_.prefix, timestamp_cache_.length);
+    out.append(suffix, options_.utc_timestamps ? 5 : 4);
 }
 
 } // namespace logger
@@ -3,14 +3,25 @@
 #include <string>
 #include <fstream>
 #include <chrono>
+#include <ctime>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include "mpsc_ring_buffer.h"
 
 namespace arcs {
 namespace logger {
 
+class AuditSegmentWriter;
+
 /**
  * Audit logger
- * Records all security-relevant events
+ * Records all security-relevant events. Callers push fixed-size records
+ * into a lock-free ring buffer; a background writer thread formats them
+ * and writes in batches, either as text lines or as binary segments
+ * (see audit_segment.h).
  */
 class AuditLogger {
 public:
@@ -33,11 +44,31 @@ public:
         CRITICAL
     };
     
+    enum class Format {
+        TEXT,       // One formatted line per record appended to log_file
+        BINARY      // mmap'd segments written into log_file as a directory
+    };
+    
+    /**
+     * Writer configuration
+     */
+    struct Options {
+        size_t queue_capacity;                    // Records buffered before dropping
+        size_t flush_batch;                       // Flush after this many records
+        std::chrono::milliseconds flush_interval; // ...or after this long
+        bool utc_timestamps;                      // ISO-8601 UTC instead of local time
+        Format format;
+        size_t segment_size;                      // BINARY segment rotation size
+    };
+    
     explicit AuditLogger(const std::string& log_file);
+    AuditLogger(const std::string& log_file, const Options& options);
     ~AuditLogger();
     
     /**
      * Log event
+     * Never blocks; fields longer than the record slots are truncated and
+     * the record is dropped (and counted) if the queue is full
      */
     void log(
         EventType event_type,
@@ -75,16 +106,79 @@ public:
     
     /**
      * Flush log
+     * Blocks until every record queued before the call is on disk
      */
     void flush();
+    
+    /**
+     * Get number of records dropped because the queue was full or the
+     * audit segment could not be written
+     */
+    size_t get_dropped_count() const;
 
 private:
-    std::string event_type_to_string(EventType type);
-    std::string log_level_to_string(LogLevel level);
-    std::string get_timestamp();
+    /**
+     * Fixed-size log record; no allocation on the caller's thread
+     */
+    struct Record {
+        std::chrono::system_clock::time_point timestamp;
+        EventType event_type;
+        LogLevel level;
+        char user_id[64];
+        char session_id[64];
+        char message[128];
+        char details[128];
+    };
+    
+    void enqueue(
+        EventType event_type,
+        LogLevel level,
+        const std::string& user_id,
+        const std::string& session_id,
+        const std::string& message,
+        const std::string& details
+    );
+    
+    static void copy_field(char* dest, size_t dest_size, const std::string& src);
+    
+    void writer_loop();
+    void format_record(const Record& record, std::string& out);
+    
+    /**
+     * @return false if the record could not be stored
+     */
+    bool write_record(const Record& record, std::string& out);
+    
+    static const char* event_type_to_string(EventType type);
+    static const char* log_level_to_string(LogLevel level);
+    
+    /**
+     * Append timestamp with milliseconds; the date/time part is only
+     * reformatted when the second changes (writer thread only)
+     */
+    void append_timestamp(std::chrono::system_clock::time_point time, std::string& out);
+    
+    struct TimestampCache {
+        std::time_t second;
+        char prefix[32];
+        size_t length;
+    };
     
+    Options options_;
     std::ofstream log_file_;
-    std::mutex mutex_;
+    std::unique_ptr<AuditSegmentWriter> segment_writer_;
+    MpscRingBuffer<Record> queue_;
+    std::atomic<size_t> dropped_;
+    TimestampCache timestamp_cache_;
+    
+    // Writer wake-up and flush handshake
+    std::mutex writer_mutex_;
+    std::condition_variable writer_cv_;
+    std::condition_variable flushed_cv_;
+    uint64_t flush_requested_;
+    uint64_t flush_completed_;
+    bool stopping_;
+    std::thread writer_;
 };
 
 } // namespace logger
@@ -0,0 +1,452 @@
+#include "audit_segment.h"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace arcs {
+namespace logger {
+
+namespace {
+
+constexpr size_t MIN_SEGMENT_SIZE = 1024 * 1024;
+constexpr size_t MAX_FIELD_LENGTH = 0xFFFF;
+
+size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+size_t string_entry_size(size_t length) {
+    return align8(sizeof(segment::StringEntry) + length);
+}
+
+size_t event_entry_size(size_t message_length, size_t details_length) {
+    return align8(sizeof(segment::EventEntry) + message_length + details_length);
+}
+
+size_t clamp_length(std::string_view value) {
+    return std::min(value.size(), MAX_FIELD_LENGTH);
+}
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // anonymous namespace
+
+// ---------------------------------------------------------------------------
+// AuditSegmentWriter
+// ---------------------------------------------------------------------------
+
+AuditSegmentWriter::AuditSegmentWriter(const std::string& directory, size_t segment_size)
+    : directory_(directory),
+      segment_size_(std::max(segment_size, MIN_SEGMENT_SIZE)),
+      sequence_(0),
+      fd_(-1),
+      base_(nullptr),
+      offset_(0)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        std::cerr << "Failed to create audit segment directory " << directory_
+                  << ": " << ec.message() << std::endl;
+    }
+}
+
+AuditSegmentWriter::~AuditSegmentWriter() {
+    close_segment();
+}
+
+bool AuditSegmentWriter::append(
+    int64_t timestamp_ms,
+    std::string_view event_type,
+    uint8_t level,
+    std::string_view user_id,
+    std::string_view session_id,
+    std::string_view message,
+    std::string_view details)
+{
+    size_t message_length = clamp_length(message);
+    size_t details_length = clamp_length(details);
+
+    // Worst case: all three interned strings are new to this segment
+    size_t needed = event_entry_size(message_length, details_length) +
+                    string_entry_size(clamp_length(event_type)) +
+                    string_entry_size(clamp_length(user_id)) +
+                    string_entry_size(clamp_length(session_id));
+    if (!reserve(needed)) {
+        return false;
+    }
+
+    segment::EventEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.timestamp_ms = timestamp_ms;
+    entry.event_type_id = intern(event_type);
+    entry.user_id = intern(user_id);
+    entry.session_id = intern(session_id);
+    entry.level = level;
+    entry.message_length = static_cast<uint16_t>(message_length);
+    entry.details_length = static_cast<uint16_t>(details_length);
+
+    uint8_t* out = write_entry(segment::ENTRY_EVENT, message_length + details_length);
+    std::memcpy(out + sizeof(segment::EntryHeader),
+                reinterpret_cast<const uint8_t*>(&entry) + sizeof(segment::EntryHeader),
+                sizeof(entry) - sizeof(segment::EntryHeader));
+    std::memcpy(out + sizeof(entry), message.data(), message_length);
+    std::memcpy(out + sizeof(entry) + message_length, details.data(), details_length);
+
+    auto* header = reinterpret_cast<segment::SegmentHeader*>(base_);
+    if (header->event_count == 0 || timestamp_ms < header->min_timestamp_ms) {
+        header->min_timestamp_ms = timestamp_ms;
+    }
+    if (header->event_count == 0 || timestamp_ms > header->max_timestamp_ms) {
+        header->max_timestamp_ms = timestamp_ms;
+    }
+    header->event_count++;
+    header->data_end = offset_;
+
+    return true;
+}
+
+void AuditSegmentWriter::sync() {
+    if (base_) {
+        msync(base_, offset_, MS_ASYNC);
+    }
+}
+
+bool AuditSegmentWriter::open_segment() {
+    int64_t created = now_ms();
+    std::string path;
+
+    // The sequence restarts with each process, so a name can already be
+    // taken by a segment from an earlier run in the same millisecond
+    do {
+        char name[64];
+        std::snprintf(name, sizeof(name), "audit-%013lld-%06llu.seg",
+                      static_cast<long long>(created),
+                      static_cast<unsigned long long>(sequence_++));
+        path = directory_ + "/" + name;
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+    } while (fd_ < 0 && errno == EEXIST);
+
+    if (fd_ < 0) {
+        std::cerr << "Failed to create audit segment " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Allocate blocks up front so a full disk fails here, not as SIGBUS
+    // on a later store into the mapping
+    int rc = posix_fallocate(fd_, 0, static_cast<off_t>(segment_size_));
+    if (rc != 0) {
+        std::cerr << "Failed to allocate audit segment " << path << ": "
+                  << std::strerror(rc) << std::endl;
+        ::close(fd_);
+        ::unlink(path.c_str());
+        fd_ = -1;
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map audit segment " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        ::close(fd_);
+        ::unlink(path.c_str());
+        fd_ = -1;
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(mapped);
+
+    segment::SegmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, segment::MAGIC, sizeof(header.magic));
+    header.version = segment::VERSION;
+    header.header_size = sizeof(segment::SegmentHeader);
+    header.created_ms = created;
+    header.data_end = sizeof(segment::SegmentHeader);
+    std::memcpy(base_, &header, sizeof(header));
+
+    offset_ = sizeof(segment::SegmentHeader);
+    strings_.clear();
+    return true;
+}
+
+void AuditSegmentWriter::close_segment() {
+    if (!base_) {
+        return;
+    }
+
+    // Trim the preallocated tail so closed segments take only what they use
+    munmap(base_, segment_size_);
+    if (ftruncate(fd_, static_cast<off_t>(offset_)) != 0) {
+        std::cerr << "Failed to trim audit segment: " << std::strerror(errno) << std::endl;
+    }
+    ::close(fd_);
+
+    base_ = nullptr;
+    fd_ = -1;
+    offset_ = 0;
+}
+
+bool AuditSegmentWriter::reserve(size_t bytes) {
+    if (base_ && offset_ + bytes <= segment_size_) {
+        return true;
+    }
+
+    close_segment();
+    if (!open_segment()) {
+        return false;
+    }
+    return offset_ + bytes <= segment_size_;
+}
+
+uint32_t AuditSegmentWriter::intern(std::string_view value) {
+    size_t length = clamp_length(value);
+    if (length == 0) {
+        return segment::NO_STRING;
+    }
+
+    lookup_key_.assign(value.data(), length);
+    auto it = strings_.find(lookup_key_);
+    if (it != strings_.end()) {
+        return it->second;
+    }
+
+    uint32_t id = static_cast<uint32_t>(strings_.size() + 1);
+
+    uint8_t* out = write_entry(segment::ENTRY_STRING, length);
+    segment::StringEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.id = id;
+    entry.length = static_cast<uint16_t>(length);
+    std::memcpy(out + sizeof(segment::EntryHeader),
+                reinterpret_cast<const uint8_t*>(&entry) + sizeof(segment::EntryHeader),
+                sizeof(entry) - sizeof(segment::EntryHeader));
+    std::memcpy(out + sizeof(entry), value.data(), length);
+
+    auto* header = reinterpret_cast<segment::SegmentHeader*>(base_);
+    header->string_count++;
+    header->data_end = offset_;
+
+    strings_.emplace(lookup_key_, id);
+    return id;
+}
+
+uint8_t* AuditSegmentWriter::write_entry(uint16_t kind, size_t payload_size) {
+    size_t body = kind == segment::ENTRY_STRING ? sizeof(segment::StringEntry)
+                                                : sizeof(segment::EventEntry);
+    size_t size = align8(body + payload_size);
+
+    uint8_t* out = base_ + offset_;
+    segment::EntryHeader header{kind, 0, static_cast<uint32_t>(size)};
+    std::memcpy(out, &header, sizeof(header));
+
+    // Zero the padding so segments are byte-for-byte reproducible
+    std::memset(out + body + payload_size, 0, size - body - payload_size);
+
+    offset_ += size;
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// AuditSegmentReader
+// ---------------------------------------------------------------------------
+
+AuditSegmentReader::AuditSegmentReader(const std::string& path)
+    : fd_(-1),
+      base_(nullptr),
+      size_(0),
+      header_(nullptr)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open audit segment " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(segment::SegmentHeader)) {
+        std::cerr << "Invalid audit segment: " << path << std::endl;
+        return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map audit segment " << path << ": "
+                  << std::strerror(errno) << std::endl;
+        return;
+    }
+    base_ = static_cast<const uint8_t*>(mapped);
+
+    const auto* header = reinterpret_cast<const segment::SegmentHeader*>(base_);
+    if (std::memcmp(header->magic, segment::MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != segment::VERSION ||
+        header->header_size < sizeof(segment::SegmentHeader)) {
+        std::cerr << "Invalid audit segment: " << path << std::endl;
+        return;
+    }
+
+    header_ = header;
+}
+
+AuditSegmentReader::~AuditSegmentReader() {
+    if (base_) {
+        munmap(const_cast<uint8_t*>(base_), size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+int64_t AuditSegmentReader::min_timestamp() const {
+    return header_ ? header_->min_timestamp_ms : 0;
+}
+
+int64_t AuditSegmentReader::max_timestamp() const {
+    return header_ ? header_->max_timestamp_ms : 0;
+}
+
+uint32_t AuditSegmentReader::event_count() const {
+    return header_ ? header_->event_count : 0;
+}
+
+size_t AuditSegmentReader::scan(
+    const AuditQuery& query,
+    const std::function<void(const AuditEntry&)>& visitor) const
+{
+    if (!header_ || header_->event_count == 0) {
+        return 0;
+    }
+
+    // Skip the whole segment when its time bounds miss the query
+    if (header_->max_timestamp_ms < query.since_ms ||
+        header_->min_timestamp_ms > query.until_ms) {
+        return 0;
+    }
+
+    // A live segment may still be growing; only trust what the header covers
+    size_t end = std::min(static_cast<size_t>(header_->data_end), size_);
+    size_t offset = header_->header_size;
+
+    // ID 0 is the empty string; later IDs are defined in order
+    std::vector<std::string_view> strings;
+    strings.reserve(header_->string_count + 1);
+    strings.emplace_back();
+
+    // Resolve filters to IDs as their definitions appear; until then no
+    // event can reference them
+    bool filter_session = !query.session_id.empty();
+    bool filter_user = !query.user_id.empty();
+    uint32_t session_match = segment::NO_STRING;
+    uint32_t user_match = segment::NO_STRING;
+
+    auto lookup = [&](uint32_t id) {
+        return id < strings.size() ? strings[id] : std::string_view();
+    };
+
+    size_t matched = 0;
+    while (offset + sizeof(segment::EntryHeader) <= end) {
+        segment::EntryHeader entry_header;
+        std::memcpy(&entry_header, base_ + offset, sizeof(entry_header));
+        if (entry_header.size < sizeof(segment::EntryHeader) || offset + entry_header.size > end) {
+            break;
+        }
+
+        const uint8_t* entry_data = base_ + offset;
+        offset += entry_header.size;
+
+        if (entry_header.kind == segment::ENTRY_STRING) {
+            segment::StringEntry entry;
+            if (entry_header.size < sizeof(entry)) {
+                break;
+            }
+            std::memcpy(&entry, entry_data, sizeof(entry));
+            if (sizeof(entry) + entry.length > entry_header.size || entry.id != strings.size()) {
+                break;
+            }
+
+            std::string_view value(reinterpret_cast<const char*>(entry_data + sizeof(entry)),
+                                   entry.length);
+            strings.push_back(value);
+
+            if (filter_session && value == query.session_id) {
+                session_match = entry.id;
+            }
+            if (filter_user && value == query.user_id) {
+                user_match = entry.id;
+            }
+        } else if (entry_header.kind == segment::ENTRY_EVENT) {
+            segment::EventEntry entry;
+            if (entry_header.size < sizeof(entry)) {
+                break;
+            }
+            std::memcpy(&entry, entry_data, sizeof(entry));
+
+            if (entry.timestamp_ms < query.since_ms || entry.timestamp_ms > query.until_ms) {
+                continue;
+            }
+            if (filter_session && (session_match == segment::NO_STRING || entry.session_id != session_match)) {
+                continue;
+            }
+            if (filter_user && (user_match == segment::NO_STRING || entry.user_id != user_match)) {
+                continue;
+            }
+            if (sizeof(entry) + entry.message_length + entry.details_length > entry_header.size) {
+                break;
+            }
+
+            const char* text = reinterpret_cast<const char*>(entry_data + sizeof(entry));
+            AuditEntry decoded;
+            decoded.timestamp_ms = entry.timestamp_ms;
+            decoded.level = entry.level;
+            decoded.event_type = lookup(entry.event_type_id);
+            decoded.user_id = lookup(entry.user_id);
+            decoded.session_id = lookup(entry.session_id);
+            decoded.message = std::string_view(text, entry.message_length);
+            decoded.details = std::string_view(text + entry.message_length, entry.details_length);
+
+            visitor(decoded);
+            matched++;
+        }
+        // Unknown entry kinds are skipped for forward compatibility
+    }
+
+    return matched;
+}
+
+std::vector<std::string> AuditSegmentReader::list_segments(const std::string& directory) {
+    std::vector<std::string> paths;
+    std::error_code ec;
+
+    for (const auto& item : std::filesystem::directory_iterator(directory, ec)) {
+        std::string name = item.path().filename().string();
+        if (name.size() > 10 && name.compare(0, 6, "audit-") == 0 &&
+            name.compare(name.size() - 4, 4, ".seg") == 0) {
+            paths.push_back(item.path().string());
+        }
+    }
+
+    if (ec) {
+        std::cerr << "Failed to list audit segments in " << directory
+                  << ": " << ec.message() << std::endl;
+    }
+
+    // Names embed a zero-padded creation time, so lexical order is age order
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+} // namespace logger
+} // namespace arcs
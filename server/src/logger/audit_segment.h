@@ -0,0 +1,204 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+namespace arcs {
+namespace logger {
+
+/**
+ * Binary audit segment format
+ *
+ * A segment is one preallocated, mmap'd file:
+ *
+ *   SegmentHeader (64 bytes)
+ *   Entry*        (8-byte aligned, in append order)
+ *
+ * Entries are either string definitions or events. Event type, user ID
+ * and session ID are interned per segment, so an event stores 32-bit IDs
+ * and a reader can filter on them with integer compares. Every segment
+ * carries its own string table and can be read on its own.
+ */
+namespace segment {
+
+constexpr char MAGIC[8] = {'A', 'R', 'C', 'S', 'A', 'U', 'D', 'T'};
+constexpr uint32_t VERSION = 1;
+
+constexpr uint16_t ENTRY_STRING = 1;
+constexpr uint16_t ENTRY_EVENT = 2;
+
+constexpr uint32_t NO_STRING = 0;  // ID of the empty string
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int64_t created_ms;
+    int64_t min_timestamp_ms;
+    int64_t max_timestamp_ms;
+    uint64_t data_end;        // Bytes in use, including this header
+    uint32_t event_count;
+    uint32_t string_count;
+    uint8_t reserved[8];
+};
+
+struct EntryHeader {
+    uint16_t kind;
+    uint16_t reserved;
+    uint32_t size;            // Whole entry including padding
+};
+
+struct StringEntry {
+    EntryHeader header;
+    uint32_t id;
+    uint16_t length;
+    uint16_t reserved;
+    // char bytes[length]
+};
+
+struct EventEntry {
+    EntryHeader header;
+    int64_t timestamp_ms;
+    uint32_t event_type_id;
+    uint32_t user_id;
+    uint32_t session_id;
+    uint8_t level;
+    uint8_t reserved;
+    uint16_t message_length;
+    uint16_t details_length;
+    // char message[message_length], details[details_length]
+};
+
+static_assert(sizeof(SegmentHeader) == 64, "segment header layout");
+static_assert(sizeof(StringEntry) == 16, "string entry layout");
+static_assert(sizeof(EventEntry) == 40, "event entry layout");
+
+} // namespace segment
+
+/**
+ * Decoded event; views point into the mapped segment
+ */
+struct AuditEntry {
+    int64_t timestamp_ms;
+    uint8_t level;
+    std::string_view event_type;
+    std::string_view user_id;
+    std::string_view session_id;
+    std::string_view message;
+    std::string_view details;
+};
+
+/**
+ * Event filter; empty strings match everything
+ */
+struct AuditQuery {
+    int64_t since_ms = std::numeric_limits<int64_t>::min();
+    int64_t until_ms = std::numeric_limits<int64_t>::max();
+    std::string session_id;
+    std::string user_id;
+};
+
+/**
+ * Append-only segment writer
+ * Not thread-safe; owned by the AuditLogger writer thread. Rolls over to
+ * a new file in the directory once the current segment is full.
+ */
+class AuditSegmentWriter {
+public:
+    /**
+     * Constructor
+     * @param directory Directory receiving audit-<ms>-<seq>.seg files
+     * @param segment_size Size each segment is preallocated to
+     */
+    AuditSegmentWriter(const std::string& directory, size_t segment_size);
+    ~AuditSegmentWriter();
+
+    AuditSegmentWriter(const AuditSegmentWriter&) = delete;
+    AuditSegmentWriter& operator=(const AuditSegmentWriter&) = delete;
+
+    /**
+     * Append one event
+     * @return false if no segment could be opened
+     */
+    bool append(
+        int64_t timestamp_ms,
+        std::string_view event_type,
+        uint8_t level,
+        std::string_view user_id,
+        std::string_view session_id,
+        std::string_view message,
+        std::string_view details
+    );
+
+    /**
+     * Schedule dirty pages of the current segment for writeback
+     */
+    void sync();
+
+private:
+    bool open_segment();
+    void close_segment();
+    bool reserve(size_t bytes);
+    uint32_t intern(std::string_view value);
+    uint8_t* write_entry(uint16_t kind, size_t payload_size);
+
+    std::string directory_;
+    size_t segment_size_;
+    uint64_t sequence_;
+
+    int fd_;
+    uint8_t* base_;
+    size_t offset_;
+    std::unordered_map<std::string, uint32_t> strings_;
+    std::string lookup_key_;  // Reused so lookups of known strings don't allocate
+};
+
+/**
+ * Read-only view of one segment
+ */
+class AuditSegmentReader {
+public:
+    explicit AuditSegmentReader(const std::string& path);
+    ~AuditSegmentReader();
+
+    AuditSegmentReader(const AuditSegmentReader&) = delete;
+    AuditSegmentReader& operator=(const AuditSegmentReader&) = delete;
+
+    bool is_open() const { return header_ != nullptr; }
+
+    /**
+     * Time bounds from the header; lets callers skip whole segments
+     */
+    int64_t min_timestamp() const;
+    int64_t max_timestamp() const;
+    uint32_t event_count() const;
+
+    /**
+     * Visit events matching the query in append order
+     * @return Number of matching events
+     */
+    size_t scan(
+        const AuditQuery& query,
+        const std::function<void(const AuditEntry&)>& visitor
+    ) const;
+
+    /**
+     * List segment files in a directory, oldest first
+     */
+    static std::vector<std::string> list_segments(const std::string& directory);
+
+private:
+    int fd_;
+    const uint8_t* base_;
+    size_t size_;
+    const segment::SegmentHeader* header_;
+};
+
+} // namespace logger
+} // namespace arcs
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace arcs {
+namespace logger {
+
+/**
+ * Bounded multi-producer, single-consumer ring buffer
+ * Producers never block: try_push fails when the buffer is full.
+ * Each cell carries a sequence number that hands ownership between
+ * producers and the consumer without a lock.
+ */
+template <typename T>
+class MpscRingBuffer {
+public:
+    /**
+     * Constructor
+     * @param capacity Number of slots, rounded up to a power of two of at
+     *                 least 2 (with one slot a full cell's sequence looks
+     *                 free to the next push)
+     */
+    explicit MpscRingBuffer(size_t capacity)
+        : capacity_(round_up_pow2(capacity)),
+          mask_(capacity_ - 1),
+          cells_(new Cell[capacity_]),
+          enqueue_pos_(0),
+          dequeue_pos_(0)
+    {
+        for (size_t i = 0; i < capacity_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    /**
+     * Push value (any thread)
+     * @return false if the buffer is full
+     */
+    bool try_push(const T& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pop value (consumer thread only)
+     * @return false if the buffer is empty
+     */
+    bool try_pop(T& out) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+            return false;
+        }
+
+        out = cell.value;
+        cell.sequence.store(pos + capacity_, std::memory_order_release);
+        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Approximate number of queued values
+     */
+    size_t size_approx() const {
+        size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 2;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(64) std::atomic<size_t> enqueue_pos_;
+    alignas(64) std::atomic<size_t> dequeue_pos_;  // Written by consumer only
+};
+
+} // namespace logger
+} // namespace arcs
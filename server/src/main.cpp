@@ -3,20 +3,52 @@
 #include <pistache/router.h>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include <signal.h>
 
 #include "auth/jwt_manager.h"
 #include "auth/device_registry.h"
+#include "websocket/connection_handler.h"
+#include "websocket/session_manager.h"
+#include "stream/stream_router.h"
 
 using namespace Pistache;
 
+/**
+ * Command line options
+ */
+struct ServerOptions {
+    int port = 9080;
+    std::string device_db_path = "devices.db";
+    uint16_t ws_port = 8080;
+    size_t io_threads = 0;          // 0 = one per core
+    bool encrypt_frames = false;
+};
+
 class ARCSServer {
 public:
-    ARCSServer(Address addr)
+    ARCSServer(Address addr, const ServerOptions& options)
         : httpEndpoint_(std::make_shared<Http::Endpoint>(addr)),
-          jwt_manager_("your-secret-key-change-me", 24),
-          device_registry_()
+          jwt_manager_(std::make_shared<arcs::auth::JWTManager>("your-secret-key-change-me", 24)),
+          device_registry_(std::make_shared<arcs::auth::DeviceRegistry>())
     {
+        if (!device_registry_->load_from_db(options.device_db_path)) {
+            std::cerr << "Device registry is memory only; changes will not persist" << std::endl;
+        }
+        
+        connection_handler_ = std::make_unique<arcs::websocket::ConnectionHandler>(
+            std::make_shared<arcs::websocket::SessionManager>(),
+            std::make_shared<arcs::stream::StreamRouter>(),
+            jwt_manager_,
+            device_registry_,
+            options.ws_port,
+            options.io_threads
+        );
+        connection_handler_->set_frame_encryption(options.encrypt_frames);
+        
         auto opts = Http::Endpoint::options()
             .threads(std::thread::hardware_concurrency())
             .flags(Tcp::Options::ReuseAddr);
@@ -26,6 +58,10 @@ public:
     
     void start() {
         std::cout << "ARCS Server starting..." << std::endl;
+        
+        // The WebSocket server runs its own I/O pool beside Pistache's
+        ws_thread_ = std::thread([this]() { connection_handler_->start(); });
+        
         httpEndpoint_->setHandler(router_.handler());
         httpEndpoint_->serve();
     }
@@ -33,6 +69,10 @@ public:
     void stop() {
         std::cout << "ARCS Server stopping..." << std::endl;
         httpEndpoint_->shutdown();
+        connection_handler_->stop();
+        if (ws_thread_.joinable()) {
+            ws_thread_.join();
+        }
     }
 
 private:
@@ -58,18 +98,36 @@ private:
     
     std::shared_ptr<Http::Endpoint> httpEndpoint_;
     Rest::Router router_;
-    arcs::auth::JWTManager jwt_manager_;
-    arcs::auth::DeviceRegistry device_registry_;
+    std::shared_ptr<arcs::auth::JWTManager> jwt_manager_;
+    std::shared_ptr<arcs::auth::DeviceRegistry> device_registry_;
+    std::unique_ptr<arcs::websocket::ConnectionHandler> connection_handler_;
+    std::thread ws_thread_;
 };
 
 int main(int argc, char* argv[]) {
-    int port = 9080;
-    if (argc > 1) {
-        port = std::atoi(argv[1]);
+    ServerOptions options;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) {
+            options.io_threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--ws-port") == 0 && i + 1 < argc) {
+            options.ws_port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--encrypt-frames") == 0) {
+            options.encrypt_frames = true;
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        } else if (positional == 0) {
+            options.port = std::atoi(argv[i]);
+            ++positional;
+        } else if (positional == 1) {
+            options.device_db_path = argv[i];
+            ++positional;
+        }
     }
     
-    Address addr(Ipv4::any(), Port(port));
-    ARCSServer server(addr);
+    Address addr(Ipv4::any(), Port(options.port));
+    ARCSServer server(addr, options);
     
     // Signal handling
     signal(SIGINT, [](int) {
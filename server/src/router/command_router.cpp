@@ -4,22 +4,35 @@
 namespace arcs {
 namespace router {
 
-std::string CommandRouter::route_to_device(
+namespace {
+
+bool is_non_negative_number(const json& command, const char* key) {
+    auto it = command.find(key);
+    return it != command.end() && it->is_number() && it->get<double>() >= 0;
+}
+
+bool is_string(const json& command, const char* key) {
+    auto it = command.find(key);
+    return it != command.end() && it->is_string();
+}
+
+} // anonymous namespace
+
+bool CommandRouter::route_to_device(
     const std::string& session_id,
     const json& command)
 {
     if (!validate_command(command)) {
         std::cerr << "Invalid command for session: " << session_id << std::endl;
-        return "";
+        return false;
     }
     
-    // Log sanitized command
+    // Log sanitized command; the original bytes are forwarded as-is
     auto sanitized = sanitize_command(command);
     std::cout << "Routing to device [" << session_id << "]: " 
               << sanitized.dump() << std::endl;
     
-    // Forward command as-is
-    return command.dump();
+    return true;
 }
 
 std::string CommandRouter::route_to_controller(
@@ -40,19 +53,22 @@ bool CommandRouter::validate_command(const json& command) {
     
     std::string type = command["type"];
     
-    // Validate coordinates for touch commands
+    // Validate coordinates for touch commands; the passthrough scanner
+    // (MessageParser::is_passthrough) applies the same rules
     if (type == "touch") {
-        if (!command.contains("action")) return false;
+        if (!is_string(command, "action")) return false;
         
         std::string action = command["action"];
         if (action == "tap" || action == "long_press") {
-            if (!command.contains("x") || !command.contains("y")) {
+            if (!is_non_negative_number(command, "x") || !is_non_negative_number(command, "y")) {
                 return false;
             }
         }
         else if (action == "swipe") {
-            if (!command.contains("start_x") || !command.contains("start_y") ||
-                !command.contains("end_x") || !command.contains("end_y")) {
+            if (!is_non_negative_number(command, "start_x") ||
+                !is_non_negative_number(command, "start_y") ||
+                !is_non_negative_number(command, "end_x") ||
+                !is_non_negative_number(command, "end_y")) {
                 return false;
             }
         }
@@ -60,13 +76,13 @@ bool CommandRouter::validate_command(const json& command) {
     
     // Validate key commands
     if (type == "key") {
-        if (!command.contains("action")) return false;
+        if (!is_string(command, "action")) return false;
         
         std::string action = command["action"];
-        if (action == "text" && !command.contains("text")) {
+        if (action == "text" && !is_string(command, "text")) {
             return false;
         }
-        if (action == "press" && !command.contains("keycode")) {
+        if (action == "press" && !is_non_negative_number(command, "keycode")) {
             return false;
         }
     }
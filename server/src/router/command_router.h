@@ -15,10 +15,10 @@ using json = nlohmann::json;
 class CommandRouter {
 public:
     /**
-     * Route command from controller to device
-     * @return Routed message or empty string if routing failed
+     * Validate and log command from controller to device
+     * @return true if the caller may forward the original message bytes
      */
-    static std::string route_to_device(
+    static bool route_to_device(
         const std::string& session_id,
         const json& command
     );
@@ -0,0 +1,133 @@
+#include "session_cipher.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <iostream>
+#include <limits>
+
+namespace arcs {
+namespace security {
+
+std::optional<SessionCipher::Key> SessionCipher::derive_key(
+    const std::string& jwt_token,
+    const std::string& device_id)
+{
+    Key key;
+    int ok = PKCS5_PBKDF2_HMAC(
+        jwt_token.data(), static_cast<int>(jwt_token.size()),
+        reinterpret_cast<const unsigned char*>(device_id.data()),
+        static_cast<int>(device_id.size()),
+        KDF_ITERATIONS, EVP_sha256(),
+        static_cast<int>(key.size()), key.data()
+    );
+    if (ok != 1) {
+        std::cerr << "Session key derivation failed" << std::endl;
+        return std::nullopt;
+    }
+    return key;
+}
+
+std::shared_ptr<SessionCipher> SessionCipher::create(
+    const std::string& jwt_token,
+    const std::string& device_id)
+{
+    auto key = derive_key(jwt_token, device_id);
+    if (!key) {
+        return nullptr;
+    }
+    
+    auto cipher = std::make_shared<SessionCipher>(*key);
+    OPENSSL_cleanse(key->data(), key->size());
+    
+    if (!cipher->is_valid()) {
+        return nullptr;
+    }
+    return cipher;
+}
+
+SessionCipher::SessionCipher(const Key& key)
+    : encrypt_ctx_(EVP_CIPHER_CTX_new()),
+      decrypt_ctx_(EVP_CIPHER_CTX_new()),
+      iv_counter_(0)
+{
+    // Key both contexts once; per message only the IV is set
+    bool ok = encrypt_ctx_ && decrypt_ctx_ &&
+              RAND_bytes(iv_prefix_.data(), static_cast<int>(iv_prefix_.size())) == 1 &&
+              EVP_EncryptInit_ex(encrypt_ctx_, EVP_aes_256_gcm(), nullptr, key.data(), nullptr) == 1 &&
+              EVP_DecryptInit_ex(decrypt_ctx_, EVP_aes_256_gcm(), nullptr, key.data(), nullptr) == 1;
+    
+    if (!ok) {
+        std::cerr << "Failed to initialize session cipher" << std::endl;
+        EVP_CIPHER_CTX_free(encrypt_ctx_);
+        EVP_CIPHER_CTX_free(decrypt_ctx_);
+        encrypt_ctx_ = nullptr;
+        decrypt_ctx_ = nullptr;
+    }
+}
+
+SessionCipher::~SessionCipher() {
+    EVP_CIPHER_CTX_free(encrypt_ctx_);
+    EVP_CIPHER_CTX_free(decrypt_ctx_);
+}
+
+bool SessionCipher::encrypt_in_place(uint8_t* message, size_t payload_size) {
+    if (!is_valid() || payload_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return false;
+    }
+    
+    uint8_t* iv = message;
+    uint8_t* payload = message + IV_SIZE;
+    uint8_t* tag = payload + payload_size;
+    
+    std::lock_guard<std::mutex> lock(encrypt_mutex_);
+    next_iv(iv);
+    
+    int length = 0;
+    if (EVP_EncryptInit_ex(encrypt_ctx_, nullptr, nullptr, nullptr, iv) != 1 ||
+        EVP_EncryptUpdate(encrypt_ctx_, payload, &length, payload, static_cast<int>(payload_size)) != 1 ||
+        EVP_EncryptFinal_ex(encrypt_ctx_, payload + length, &length) != 1 ||
+        EVP_CIPHER_CTX_ctrl(encrypt_ctx_, EVP_CTRL_GCM_GET_TAG, static_cast<int>(TAG_SIZE), tag) != 1) {
+        std::cerr << "Payload encryption failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SessionCipher::decrypt_in_place(uint8_t* message, size_t message_size, size_t& payload_size) {
+    if (!is_valid() || message_size < OVERHEAD ||
+        message_size - OVERHEAD > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        return false;
+    }
+    
+    const uint8_t* iv = message;
+    uint8_t* payload = message + IV_SIZE;
+    size_t size = message_size - OVERHEAD;
+    uint8_t* tag = payload + size;
+    
+    std::lock_guard<std::mutex> lock(decrypt_mutex_);
+    
+    int length = 0;
+    if (EVP_DecryptInit_ex(decrypt_ctx_, nullptr, nullptr, nullptr, iv) != 1 ||
+        EVP_DecryptUpdate(decrypt_ctx_, payload, &length, payload, static_cast<int>(size)) != 1 ||
+        EVP_CIPHER_CTX_ctrl(decrypt_ctx_, EVP_CTRL_GCM_SET_TAG, static_cast<int>(TAG_SIZE), tag) != 1 ||
+        EVP_DecryptFinal_ex(decrypt_ctx_, payload + length, &length) != 1) {
+        // Tag mismatch: the payload bytes are garbage and must not be used
+        return false;
+    }
+    
+    payload_size = size;
+    return true;
+}
+
+void SessionCipher::next_iv(uint8_t* iv) {
+    uint64_t counter = iv_counter_++;
+    for (size_t i = 0; i < iv_prefix_.size(); ++i) {
+        iv[i] = iv_prefix_[i];
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        iv[iv_prefix_.size() + i] = static_cast<uint8_t>(counter >> (56 - 8 * i));
+    }
+}
+
+} // namespace security
+} // namespace arcs
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+namespace arcs {
+namespace security {
+
+/**
+ * Session cipher
+ * AES-256-GCM payload encryption with the session key from the protocol:
+ *
+ *   session_key = PBKDF2-HMAC-SHA256(jwt_token, device_id, 100000, 32)
+ *
+ * The key is derived once per token, by SessionManager::get_cipher on the
+ * session's first use. Each direction keeps one EVP context keyed at
+ * construction, so a message only resets the IV. Messages use the wire
+ * layout
+ *
+ *   [IV: 12 bytes][Encrypted Data: N bytes][Auth Tag: 16 bytes]
+ *
+ * and are encrypted and decrypted in place in the caller's buffer.
+ */
+class SessionCipher {
+public:
+    using Key = std::array<uint8_t, 32>;
+    
+    static constexpr size_t IV_SIZE = 12;
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr size_t OVERHEAD = IV_SIZE + TAG_SIZE;
+    static constexpr int KDF_ITERATIONS = 100000;
+    
+    /**
+     * Derive the session key (slow by design; call once per token)
+     */
+    static std::optional<Key> derive_key(const std::string& jwt_token,
+                                         const std::string& device_id);
+    
+    /**
+     * Derive the key and build a cipher for it
+     * @return nullptr on failure
+     */
+    static std::shared_ptr<SessionCipher> create(const std::string& jwt_token,
+                                                 const std::string& device_id);
+    
+    explicit SessionCipher(const Key& key);
+    ~SessionCipher();
+    
+    SessionCipher(const SessionCipher&) = delete;
+    SessionCipher& operator=(const SessionCipher&) = delete;
+    
+    bool is_valid() const { return encrypt_ctx_ != nullptr && decrypt_ctx_ != nullptr; }
+    
+    /**
+     * Encrypt in place
+     * @param message Buffer of payload_size + OVERHEAD bytes; the payload
+     *                starts at message + IV_SIZE and is overwritten with
+     *                ciphertext, the IV and tag slots are filled in
+     */
+    bool encrypt_in_place(uint8_t* message, size_t payload_size);
+    
+    /**
+     * Decrypt in place and verify the tag
+     * @param message Buffer holding [IV][ciphertext][tag]
+     * @param payload_size Set to the plaintext size; the plaintext is left
+     *                     at message + IV_SIZE
+     */
+    bool decrypt_in_place(uint8_t* message, size_t message_size, size_t& payload_size);
+
+private:
+    void next_iv(uint8_t* iv);
+    
+    EVP_CIPHER_CTX* encrypt_ctx_;
+    EVP_CIPHER_CTX* decrypt_ctx_;
+    std::mutex encrypt_mutex_;
+    std::mutex decrypt_mutex_;
+    
+    // Deterministic IVs: random per-cipher prefix plus a message counter,
+    // so IVs never repeat under one key and no RNG call is needed per message
+    std::array<uint8_t, 4> iv_prefix_;
+    uint64_t iv_counter_;
+};
+
+} // namespace security
+} // namespace arcs
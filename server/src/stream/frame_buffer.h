@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <chrono>
+#include "protocol/frame_header.h"
+
+namespace arcs {
+namespace stream {
+
+/**
+ * Per-frame metadata
+ * Decoded from the ARCS header once at ingress and carried with the
+ * buffer, so the router and sinks never re-parse the bytes
+ */
+struct FrameMetadata {
+    bool has_header = false;        // false for raw streams without ARCS framing
+    uint32_t frame_number = 0;
+    uint64_t timestamp_us = 0;      // Device presentation time
+    uint8_t flags = 0;
+    uint16_t fragment_index = 0;
+    uint16_t fragment_count = 1;
+    uint32_t payload_offset = 0;
+    uint32_t payload_size = 0;
+    std::chrono::steady_clock::time_point received_at;  // Relay ingress time
+
+    bool is_keyframe() const { return (flags & protocol::FRAME_FLAG_KEYFRAME) != 0; }
+    bool is_fragment() const { return (flags & protocol::FRAME_FLAG_FRAGMENT) != 0; }
+
+    static FrameMetadata from_header(const protocol::FrameHeader& header,
+                                     std::chrono::steady_clock::time_point received_at) {
+        FrameMetadata meta;
+        meta.has_header = true;
+        meta.frame_number = header.frame_number;
+        meta.timestamp_us = header.timestamp_us;
+        meta.flags = header.flags;
+        meta.fragment_index = header.fragment_index;
+        meta.fragment_count = header.fragment_count;
+        meta.payload_offset = static_cast<uint32_t>(header.payload_offset);
+        meta.payload_size = header.payload_size;
+        meta.received_at = received_at;
+        return meta;
+    }
+};
+
+/**
+ * Frame buffer
+ * Immutable, reference-counted view of one binary frame. Copies of a
+ * FrameBuffer share the same bytes, so fan-out to N controllers costs
+ * N reference-count increments instead of N memcpys.
+ */
+class FrameBuffer {
+public:
+    FrameBuffer() : size_(0) {}
+
+    /**
+     * Wrap bytes owned by another object (e.g. a websocketpp message)
+     * The owner is kept alive for as long as any handle exists
+     */
+    template <typename Owner>
+    static FrameBuffer wrap(const std::shared_ptr<Owner>& owner,
+                            const uint8_t* data,
+                            size_t size) {
+        return FrameBuffer(std::shared_ptr<const uint8_t>(owner, data), size);
+    }
+
+    /**
+     * Copy bytes into a newly allocated shared buffer
+     */
+    static FrameBuffer copy(const uint8_t* data, size_t size) {
+        std::shared_ptr<uint8_t> storage(new uint8_t[size], std::default_delete<uint8_t[]>());
+        if (size > 0) {
+            std::memcpy(storage.get(), data, size);
+        }
+        return FrameBuffer(std::shared_ptr<const uint8_t>(storage, storage.get()), size);
+    }
+
+    /**
+     * Same bytes with metadata attached
+     */
+    FrameBuffer with_metadata(const FrameMetadata& metadata) const {
+        FrameBuffer frame(*this);
+        frame.metadata_ = metadata;
+        return frame;
+    }
+
+    /**
+     * Same frame with a ready-to-send transport message attached
+     * Built once at ingress (e.g. a prepared websocket message over these
+     * bytes) so every sink queues the same object instead of a copy
+     */
+    FrameBuffer with_prepared(std::shared_ptr<void> prepared) const {
+        FrameBuffer frame(*this);
+        frame.prepared_ = std::move(prepared);
+        return frame;
+    }
+
+    const uint8_t* data() const { return data_.get(); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const FrameMetadata& metadata() const { return metadata_; }
+    const std::shared_ptr<void>& prepared() const { return prepared_; }
+
+private:
+    FrameBuffer(std::shared_ptr<const uint8_t> data, size_t size)
+        : data_(std::move(data)), size_(size) {}
+
+    std::shared_ptr<const uint8_t> data_;
+    size_t size_;
+    FrameMetadata metadata_;
+    std::shared_ptr<void> prepared_;  // Null unless attached at ingress
+};
+
+} // namespace stream
+} // namespace arcs
@@ -1,34 +1,47 @@
 #include "stream_router.h"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include "protocol/frame_header.h"
 
 namespace arcs {
 namespace stream {
 
+namespace {
+
+constexpr double LATENCY_EWMA_WEIGHT = 1.0 / 16;
+
+} // namespace
+
 void StreamRouter::register_device(const std::string& session_id, const std::string& device_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto& shard = shard_for(session_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
     
-    auto it = endpoints_.find(session_id);
-    if (it == endpoints_.end()) {
+    auto it = shard.endpoints.find(session_id);
+    if (it == shard.endpoints.end()) {
         auto endpoint = std::make_shared<StreamEndpoint>();
         endpoint->session_id = session_id;
         endpoint->device_id = device_id;
-        endpoint->stats = {0, 0, 0, 0.0};
-        endpoints_[session_id] = endpoint;
+        endpoint->stats = Stats();
+        shard.endpoints[session_id] = endpoint;
         
         std::cout << "Registered device stream: " << device_id 
                   << " for session: " << session_id << std::endl;
     }
 }
 
-void StreamRouter::register_controller(const std::string& session_id, const std::string& controller_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = endpoints_.find(session_id);
-    if (it != endpoints_.end()) {
-        std::lock_guard<std::mutex> endpoint_lock(it->second->mutex);
+void StreamRouter::register_controller(
+    const std::string& session_id,
+    const std::string& controller_id,
+    FrameSink sink)
+{
+    auto endpoint = find_endpoint(session_id);
+    if (endpoint) {
+        std::lock_guard<std::mutex> endpoint_lock(endpoint->mutex);
         
-        it->second->controller_ids.push_back(controller_id);
-        it->second->frame_queues[controller_id] = std::queue<std::vector<uint8_t>>();
+        ControllerState state;
+        state.sink = std::move(sink);
+        endpoint->controller_states[controller_id] = std::move(state);
         
         std::cout << "Registered controller stream: " << controller_id 
                   << " for session: " << session_id << std::endl;
@@ -40,71 +53,163 @@ void StreamRouter::route_frame(
     const uint8_t* data,
     size_t size)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    FrameMetadata meta;
+    protocol::FrameHeader header;
+    if (protocol::parse_frame(data, size, header, protocol::FrameValidation::TRUSTED) ==
+        protocol::FrameStatus::OK) {
+        meta = FrameMetadata::from_header(header, std::chrono::steady_clock::now());
+    } else {
+        meta.received_at = std::chrono::steady_clock::now();
+    }
     
-    auto it = endpoints_.find(session_id);
-    if (it == endpoints_.end()) {
+    route_frame(session_id, FrameBuffer::copy(data, size).with_metadata(meta));
+}
+
+void StreamRouter::route_frame(
+    const std::string& session_id,
+    const FrameBuffer& frame)
+{
+    auto endpoint = find_endpoint(session_id);
+    if (!endpoint) {
         return;
     }
     
-    std::lock_guard<std::mutex> endpoint_lock(it->second->mutex);
+    std::lock_guard<std::mutex> endpoint_lock(endpoint->mutex);
+    
+    const FrameMetadata& meta = frame.metadata();
+    
+    // Update stats; fragments add bytes, only a frame's first counts it
+    if (meta.is_fragment()) {
+        endpoint->stats.total_fragments++;
+    }
+    if (!meta.is_fragment() || meta.fragment_index == 0) {
+        endpoint->stats.total_frames++;
+    }
+    endpoint->stats.total_bytes += frame.size();
+    if (endpoint->stats.total_frames > 0) {
+        endpoint->stats.avg_frame_size = 
+            static_cast<double>(endpoint->stats.total_bytes) / 
+            endpoint->stats.total_frames;
+    }
+    
+    if (meta.has_header) {
+        check_sequence(*endpoint, meta);
+    }
     
-    // Update stats
-    it->second->stats.total_frames++;
-    it->second->stats.total_bytes += size;
-    it->second->stats.avg_frame_size = 
-        static_cast<double>(it->second->stats.total_bytes) / 
-        it->second->stats.total_frames;
+    // Push to all controllers
+    for (auto& pair : endpoint->controller_states) {
+        deliver_frame(pair.second, frame, endpoint->stats);
+    }
     
-    // Copy frame data
-    std::vector<uint8_t> frame(data, data + size);
+    // Per-hop latency: ingress to the last controller hand-off
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - meta.received_at).count();
+    uint64_t latency_us = latency > 0 ? static_cast<uint64_t>(latency) : 0;
+    Stats& stats = endpoint->stats;
+    stats.max_relay_latency_us = std::max(stats.max_relay_latency_us, latency_us);
+    if (!endpoint->has_latency_sample) {
+        endpoint->has_latency_sample = true;
+        stats.avg_relay_latency_us = static_cast<double>(latency_us);
+    } else {
+        stats.avg_relay_latency_us +=
+            LATENCY_EWMA_WEIGHT * (static_cast<double>(latency_us) - stats.avg_relay_latency_us);
+    }
+}
+
+void StreamRouter::check_sequence(StreamEndpoint& endpoint, const FrameMetadata& meta) {
+    if (!endpoint.has_last_frame) {
+        endpoint.has_last_frame = true;
+        endpoint.last_frame_number = meta.frame_number;
+        return;
+    }
     
-    // Route to all controllers
-    for (const auto& controller_id : it->second->controller_ids) {
-        auto& queue = it->second->frame_queues[controller_id];
-        
-        // Drop old frames if queue is full
-        if (queue.size() >= MAX_QUEUE_SIZE) {
-            queue.pop();
-            it->second->stats.dropped_frames++;
+    // Signed distance handles 32-bit wraparound; 0 is another fragment of
+    // the same frame and negative means the device restarted its counter
+    int32_t delta = static_cast<int32_t>(meta.frame_number - endpoint.last_frame_number);
+    endpoint.last_frame_number = meta.frame_number;
+    if (delta <= 1) {
+        return;
+    }
+    
+    endpoint.stats.sequence_gaps++;
+    endpoint.stats.missing_frames += static_cast<size_t>(delta - 1);
+    
+    if (!meta.is_keyframe()) {
+        for (auto& pair : endpoint.controller_states) {
+            pair.second.awaiting_keyframe = true;
         }
-        
-        queue.push(frame);
     }
 }
 
-bool StreamRouter::get_frame(
-    const std::string& session_id,
-    const std::string& controller_id,
-    std::vector<uint8_t>& out_data)
+void StreamRouter::deliver_frame(
+    ControllerState& state,
+    const FrameBuffer& frame,
+    Stats& stats)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    const FrameMetadata& meta = frame.metadata();
     
-    auto it = endpoints_.find(session_id);
-    if (it == endpoints_.end()) {
-        return false;
+    if (!meta.is_fragment() || meta.fragment_index == 0) {
+        // The open frame never completed; its tail was lost upstream
+        if (state.frame_open) {
+            state.frame_open = false;
+            state.awaiting_keyframe = true;
+            stats.dropped_frames++;
+        }
+        
+        // New viewer, or one that lost its reference picture; skip until
+        // the next keyframe. Raw streams carry no flag to wait for.
+        if (state.awaiting_keyframe) {
+            if (meta.has_header && !meta.is_keyframe()) {
+                stats.dropped_frames++;
+                return;
+            }
+            state.awaiting_keyframe = false;
+        }
+        
+        state.frame_open = meta.is_fragment();
+        state.open_frame_number = meta.frame_number;
+        state.next_fragment_index = 1;
+    } else if (state.awaiting_keyframe) {
+        // Tail of a frame this controller is skipping; already counted
+        return;
+    } else if (!state.frame_open || state.open_frame_number != meta.frame_number ||
+               meta.fragment_index != state.next_fragment_index) {
+        // A fragment went missing, so the frame cannot be reassembled
+        state.frame_open = false;
+        state.awaiting_keyframe = true;
+        stats.dropped_frames++;
+        return;
+    } else {
+        state.next_fragment_index++;
     }
     
-    std::lock_guard<std::mutex> endpoint_lock(it->second->mutex);
-    
-    auto queue_it = it->second->frame_queues.find(controller_id);
-    if (queue_it == it->second->frame_queues.end() || queue_it->second.empty()) {
-        return false;
+    if (state.sink(frame)) {
+        if (state.frame_open && state.next_fragment_index >= meta.fragment_count) {
+            state.frame_open = false;  // Last fragment sent
+        }
+        return;
     }
     
-    out_data = std::move(queue_it->second.front());
-    queue_it->second.pop();
+    // A partially sent frame is as useless as an unsent one
+    stats.dropped_frames++;
+    state.frame_open = false;
     
-    return true;
+    // Rest of this GOP is undecodable without the dropped frame.
+    // Frames without an ARCS header carry no keyframe flag to resync on.
+    if (meta.has_header) {
+        state.awaiting_keyframe = true;
+        stats.dropped_gops++;
+    }
 }
 
 void StreamRouter::unregister_device(const std::string& session_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto& shard = shard_for(session_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
     
-    auto it = endpoints_.find(session_id);
-    if (it != endpoints_.end()) {
+    auto it = shard.endpoints.find(session_id);
+    if (it != shard.endpoints.end()) {
         std::cout << "Unregistered device stream for session: " << session_id << std::endl;
-        endpoints_.erase(it);
+        shard.endpoints.erase(it);
     }
 }
 
@@ -112,21 +217,12 @@ void StreamRouter::unregister_controller(
     const std::string& session_id,
     const std::string& controller_id)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = endpoints_.find(session_id);
-    if (it != endpoints_.end()) {
-        std::lock_guard<std::mutex> endpoint_lock(it->second->mutex);
-        
-        // Remove controller from list
-        auto& controllers = it->second->controller_ids;
-        controllers.erase(
-            std::remove(controllers.begin(), controllers.end(), controller_id),
-            controllers.end()
-        );
+    auto endpoint = find_endpoint(session_id);
+    if (endpoint) {
+        std::lock_guard<std::mutex> endpoint_lock(endpoint->mutex);
         
-        // Remove frame queue
-        it->second->frame_queues.erase(controller_id);
+        // Dropping the state releases the sink and its connection
+        endpoint->controller_states.erase(controller_id);
         
         std::cout << "Unregistered controller stream: " << controller_id 
                   << " from session: " << session_id << std::endl;
@@ -134,15 +230,34 @@ void StreamRouter::unregister_controller(
 }
 
 StreamRouter::Stats StreamRouter::get_stats(const std::string& session_id) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = endpoints_.find(session_id);
-    if (it != endpoints_.end()) {
-        std::lock_guard<std::mutex> endpoint_lock(it->second->mutex);
-        return it->second->stats;
+    auto endpoint = find_endpoint(session_id);
+    if (endpoint) {
+        std::lock_guard<std::mutex> endpoint_lock(endpoint->mutex);
+        return endpoint->stats;
     }
     
-    return {0, 0, 0, 0.0};
+    return Stats();
+}
+
+StreamRouter::Shard& StreamRouter::shard_for(const std::string& session_id) {
+    return shards_[std::hash<std::string>{}(session_id) % SHARD_COUNT];
+}
+
+const StreamRouter::Shard& StreamRouter::shard_for(const std::string& session_id) const {
+    return shards_[std::hash<std::string>{}(session_id) % SHARD_COUNT];
+}
+
+std::shared_ptr<StreamRouter::StreamEndpoint> StreamRouter::find_endpoint(
+    const std::string& session_id) const
+{
+    const auto& shard = shard_for(session_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    
+    auto it = shard.endpoints.find(session_id);
+    if (it != shard.endpoints.end()) {
+        return it->second;
+    }
+    return nullptr;
 }
 
 } // namespace stream
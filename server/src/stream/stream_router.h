@@ -1,10 +1,15 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <map>
+#include <unordered_map>
+#include <array>
 #include <mutex>
-#include <queue>
+#include <shared_mutex>
 #include <memory>
+#include <functional>
+#include "frame_buffer.h"
 
 namespace arcs {
 namespace stream {
@@ -15,6 +20,13 @@ namespace stream {
  */
 class StreamRouter {
 public:
+    /**
+     * Frame delivery callback for one controller
+     * Returns false if the controller's connection is backpressured and
+     * the frame was not sent
+     */
+    using FrameSink = std::function<bool(const FrameBuffer& frame)>;
+    
     /**
      * Register stream endpoint
      */
@@ -22,11 +34,18 @@ public:
     
     /**
      * Register stream receiver
+     * @param sink Pushes frames to this controller's connection; called
+     *             with only this session's endpoint lock held
      */
-    void register_controller(const std::string& session_id, const std::string& controller_id);
+    void register_controller(
+        const std::string& session_id,
+        const std::string& controller_id,
+        FrameSink sink
+    );
     
     /**
      * Route video frame from device to controllers
+     * Copies the bytes once into a shared buffer and parses its header
      */
     void route_frame(
         const std::string& session_id,
@@ -35,12 +54,14 @@ public:
     );
     
     /**
-     * Get pending frames for controller
+     * Route shared video frame from device to controllers
+     * Every controller queue holds a handle to the same bytes. The frame's
+     * metadata must already be filled in at ingress. Fragments are
+     * forwarded as they arrive (cut-through); stats count whole frames.
      */
-    bool get_frame(
+    void route_frame(
         const std::string& session_id,
-        const std::string& controller_id,
-        std::vector<uint8_t>& out_data
+        const FrameBuffer& frame
     );
     
     /**
@@ -53,28 +74,77 @@ public:
      * Get statistics
      */
     struct Stats {
-        size_t total_frames;
-        size_t total_bytes;
-        size_t dropped_frames;
-        double avg_frame_size;
+        size_t total_frames = 0;          // Whole frames, not fragments
+        size_t total_fragments = 0;
+        size_t total_bytes = 0;
+        size_t dropped_frames = 0;
+        size_t dropped_gops = 0;          // GOPs discarded under backpressure
+        double avg_frame_size = 0.0;
+        size_t sequence_gaps = 0;         // Breaks in the device's frame numbering
+        size_t missing_frames = 0;        // Frame numbers skipped across those gaps
+        double avg_relay_latency_us = 0.0;  // Ingress to hand-off, moving average
+        uint64_t max_relay_latency_us = 0;
     };
     
     Stats get_stats(const std::string& session_id) const;
 
 private:
+    struct ControllerState {
+        FrameSink sink;
+        bool awaiting_keyframe = true;   // Resync point: on join and after a dropped GOP
+        bool frame_open = false;         // Forwarding a fragmented frame
+        uint32_t open_frame_number = 0;
+        uint16_t next_fragment_index = 0;  // Expected next fragment of the open frame
+    };
+    
     struct StreamEndpoint {
         std::string session_id;
         std::string device_id;
-        std::vector<std::string> controller_ids;
-        std::map<std::string, std::queue<std::vector<uint8_t>>> frame_queues;
+        bool has_last_frame = false;
+        uint32_t last_frame_number = 0;
+        bool has_latency_sample = false;  // Seeds the latency average
+        std::map<std::string, ControllerState> controller_states;
         Stats stats;
         std::mutex mutex;
     };
     
-    std::map<std::string, std::shared_ptr<StreamEndpoint>> endpoints_;
-    std::mutex mutex_;
+    /**
+     * Track frame numbering; on a gap the missing frames' dependents are
+     * undecodable, so every controller waits for the next keyframe
+     */
+    void check_sequence(StreamEndpoint& endpoint, const FrameMetadata& meta);
+    
+    /**
+     * Push frame (or fragment) to one controller, dropping the rest of the
+     * GOP when its connection is backpressured. A fragmented frame is only
+     * forwarded from its first fragment and is abandoned as a whole once
+     * any fragment fails or goes missing.
+     */
+    void deliver_frame(
+        ControllerState& state,
+        const FrameBuffer& frame,
+        Stats& stats
+    );
+    
+    static constexpr size_t SHARD_COUNT = 64;
+    
+    /**
+     * Endpoint table shard, selected by session ID hash
+     */
+    struct Shard {
+        std::unordered_map<std::string, std::shared_ptr<StreamEndpoint>> endpoints;
+        mutable std::shared_mutex mutex;
+    };
+    
+    Shard& shard_for(const std::string& session_id);
+    const Shard& shard_for(const std::string& session_id) const;
+    
+    /**
+     * Look up endpoint under a shared shard lock
+     */
+    std::shared_ptr<StreamEndpoint> find_endpoint(const std::string& session_id) const;
     
-    static constexpr size_t MAX_QUEUE_SIZE = 30;  // 1 second at 30fps
+    std::array<Shard, SHARD_COUNT> shards_;
 };
 
 } // namespace stream
@@ -2,21 +2,60 @@
 #include "session_manager.h"
 #include "message_parser.h"
 #include "../auth/jwt_manager.h"
+#include "../auth/device_registry.h"
+#include "../stream/stream_router.h"
+#include "../router/command_router.h"
+#include "../security/session_cipher.h"
+#include "protocol/frame_header.h"
+#include "protocol/crc32.h"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
 #include <uuid/uuid.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/sockios.h>
 
 namespace arcs {
 namespace websocket {
 
+namespace {
+
+// Header fields rewritten when a frame is encrypted (see frame_header.h)
+constexpr size_t FRAME_FLAGS_OFFSET = 18;
+constexpr size_t FRAME_PAYLOAD_LENGTH_OFFSET = 19;
+
+inline void write_be32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+} // anonymous namespace
+
 ConnectionHandler::ConnectionHandler(
     std::shared_ptr<SessionManager> session_manager,
-    uint16_t port)
+    std::shared_ptr<stream::StreamRouter> stream_router,
+    std::shared_ptr<auth::JWTManager> jwt_manager,
+    std::shared_ptr<auth::DeviceRegistry> device_registry,
+    uint16_t port,
+    size_t io_threads)
     : session_manager_(session_manager),
-      port_(port)
+      stream_router_(stream_router),
+      jwt_manager_(jwt_manager),
+      device_registry_(device_registry),
+      port_(port),
+      io_threads_(io_threads > 0 ? io_threads : std::max(1u, std::thread::hardware_concurrency())),
+      send_high_water_mark_(DEFAULT_SEND_HIGH_WATER_MARK),
+      encrypt_frames_(false)
 {
     // Initialize WebSocket server
     ws_server_.init_asio();
     ws_server_.set_reuse_addr(true);
+    ws_server_.set_max_message_size(MAX_MESSAGE_SIZE);
     
     // Set handlers
     ws_server_.set_open_handler(bind(&ConnectionHandler::on_open, this, _1));
@@ -31,10 +70,24 @@ void ConnectionHandler::start() {
     ws_server_.listen(port_);
     ws_server_.start_accept();
     
-    std::cout << "WebSocket server started" << std::endl;
+    std::cout << "WebSocket server started with " << io_threads_
+              << " I/O threads" << std::endl;
+    
+    // All threads run the same io_service. The asio transport wraps each
+    // connection's handlers in its own strand, so per-connection ordering
+    // holds while different connections are served on different cores.
+    std::vector<std::thread> workers;
+    workers.reserve(io_threads_ - 1);
+    for (size_t i = 1; i < io_threads_; ++i) {
+        workers.emplace_back([this]() { ws_server_.run(); });
+    }
     
-    // Run in current thread
+    // Current thread joins the pool
     ws_server_.run();
+    
+    for (auto& worker : workers) {
+        worker.join();
+    }
 }
 
 void ConnectionHandler::stop() {
@@ -60,29 +113,31 @@ void ConnectionHandler::send(const std::string& connection_id, const std::string
 void ConnectionHandler::send_to_device(const std::string& session_id, const std::string& message) {
     std::lock_guard<std::mutex> lock(connections_mutex_);
     
-    for (const auto& [id, conn] : connections_) {
-        if (conn->session_id == session_id && conn->is_device) {
-            try {
-                ws_server_.send(conn->hdl, message, websocketpp::frame::opcode::text);
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to send to device: " << e.what() << std::endl;
-            }
-            break;
-        }
+    auto it = session_routes_.find(session_id);
+    if (it == session_routes_.end() || !it->second.device) {
+        return;
+    }
+    
+    try {
+        ws_server_.send(it->second.device->hdl, message, websocketpp::frame::opcode::text);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to send to device: " << e.what() << std::endl;
     }
 }
 
 void ConnectionHandler::send_to_controller(const std::string& session_id, const std::string& message) {
     std::lock_guard<std::mutex> lock(connections_mutex_);
     
-    for (const auto& [id, conn] : connections_) {
-        if (conn->session_id == session_id && !conn->is_device) {
-            try {
-                ws_server_.send(conn->hdl, message, websocketpp::frame::opcode::text);
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to send to controller: " << e.what() << std::endl;
-            }
-            break;
+    auto it = session_routes_.find(session_id);
+    if (it == session_routes_.end()) {
+        return;
+    }
+    
+    for (const auto& conn : it->second.controllers) {
+        try {
+            ws_server_.send(conn->hdl, message, websocketpp::frame::opcode::text);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to send to controller: " << e.what() << std::endl;
         }
     }
 }
@@ -90,15 +145,70 @@ void ConnectionHandler::send_to_controller(const std::string& session_id, const
 void ConnectionHandler::broadcast_to_session(const std::string& session_id, const std::string& message) {
     std::lock_guard<std::mutex> lock(connections_mutex_);
     
-    for (const auto& [id, conn] : connections_) {
-        if (conn->session_id == session_id) {
-            try {
-                ws_server_.send(conn->hdl, message, websocketpp::frame::opcode::text);
-            } catch (const std::exception& e) {
-                std::cerr << "Failed to broadcast: " << e.what() << std::endl;
+    auto it = session_routes_.find(session_id);
+    if (it == session_routes_.end()) {
+        return;
+    }
+    
+    std::vector<std::shared_ptr<ConnectionInfo>> targets = it->second.controllers;
+    if (it->second.device) {
+        targets.push_back(it->second.device);
+    }
+    
+    for (const auto& conn : targets) {
+        try {
+            ws_server_.send(conn->hdl, message, websocketpp::frame::opcode::text);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to broadcast: " << e.what() << std::endl;
+        }
+    }
+}
+
+void ConnectionHandler::set_send_high_water_mark(size_t bytes) {
+    send_high_water_mark_ = bytes;
+}
+
+void ConnectionHandler::set_frame_encryption(bool enabled) {
+    encrypt_frames_ = enabled;
+}
+
+bool ConnectionHandler::send_frame(
+    const FrameSink& sink,
+    const stream::FrameBuffer& frame)
+{
+    // Socket backpressure decides queue depth, not a fixed frame count.
+    // websocketpp's buffered amount is guarded by a lock it does not
+    // expose, so the kernel's queue is read instead; asio only holds
+    // bytes back in user space while that queue is full. The limit is
+    // capped by the socket's current (autotuned) send buffer, otherwise
+    // a small buffer would never reach it.
+    if (sink.fd >= 0) {
+        int queued = 0;
+        int sndbuf = 0;
+        socklen_t len = sizeof(sndbuf);
+        if (ioctl(sink.fd, SIOCOUTQ, &queued) == 0 &&
+            getsockopt(sink.fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) == 0) {
+            // The kernel reports twice the usable size to cover overhead
+            size_t limit = std::min(sink.high_water_mark, static_cast<size_t>(sndbuf) / 2);
+            if (static_cast<size_t>(queued) >= limit) {
+                return false;
             }
         }
     }
+    
+    // Frames from ingress carry one prepared message shared by every
+    // controller; anything else is framed per connection
+    websocketpp::lib::error_code ec;
+    if (frame.prepared()) {
+        ec = sink.con->send(std::static_pointer_cast<server::message_type>(frame.prepared()));
+    } else {
+        ec = sink.con->send(frame.data(), frame.size(), websocketpp::frame::opcode::binary);
+    }
+    if (ec) {
+        std::cerr << "Failed to send frame: " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
 }
 
 void ConnectionHandler::close_connection(const std::string& connection_id) {
@@ -135,6 +245,7 @@ void ConnectionHandler::on_open(connection_hdl hdl) {
     conn->connection_id = connection_id;
     conn->authenticated = false;
     conn->connected_at = std::chrono::system_clock::now();
+    conn->binary_control = false;
     
     connections_[connection_id] = conn;
     hdl_to_id_[hdl] = connection_id;
@@ -143,23 +254,40 @@ void ConnectionHandler::on_open(connection_hdl hdl) {
 }
 
 void ConnectionHandler::on_close(connection_hdl hdl) {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    
-    auto it = hdl_to_id_.find(hdl);
-    if (it != hdl_to_id_.end()) {
-        std::string connection_id = it->second;
+    std::shared_ptr<ConnectionInfo> conn;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
         
-        // Clean up session if authenticated
-        auto conn_it = connections_.find(connection_id);
-        if (conn_it != connections_.end() && conn_it->second->authenticated) {
-            session_manager_->close_session(conn_it->second->session_id);
+        auto it = hdl_to_id_.find(hdl);
+        if (it == hdl_to_id_.end()) {
+            return;
         }
         
-        connections_.erase(connection_id);
+        auto conn_it = connections_.find(it->second);
+        if (conn_it != connections_.end()) {
+            conn = conn_it->second;
+            unindex_connection(conn);
+            connections_.erase(conn_it);
+        }
         hdl_to_id_.erase(it);
-        
-        std::cout << "Connection closed: " << connection_id << std::endl;
     }
+    
+    if (!conn) {
+        return;
+    }
+    
+    // Clean up session if authenticated. Done outside connections_mutex_
+    // so the global lock is never held across stream router calls.
+    if (conn->authenticated) {
+        if (conn->is_device) {
+            stream_router_->unregister_device(conn->session_id);
+        } else {
+            stream_router_->unregister_controller(conn->session_id, conn->connection_id);
+        }
+        session_manager_->close_session(conn->session_id);
+    }
+    
+    std::cout << "Connection closed: " << conn->connection_id << std::endl;
 }
 
 void ConnectionHandler::on_message(connection_hdl hdl, message_ptr msg) {
@@ -168,18 +296,31 @@ void ConnectionHandler::on_message(connection_hdl hdl, message_ptr msg) {
         return;
     }
     
-    std::string payload = msg->get_payload();
+    // Video frames bypass JSON handling entirely
+    if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
+        handle_binary_frame(hdl, connection_id, msg);
+        return;
+    }
+    
+    const std::string& payload = msg->get_payload();
+    
+    // Fast path: high-rate input commands are forwarded without full parsing
+    if (MessageParser::is_passthrough(MessageParser::peek(payload))) {
+        handle_passthrough_command(connection_id, payload);
+        return;
+    }
     
     try {
-        auto msg_type = MessageParser::get_message_type(payload);
+        // Parse once; handlers receive typed requests
+        auto parsed = MessageParser::parse(payload);
         
-        switch (msg_type) {
+        switch (parsed.type) {
             case MessageParser::MessageType::AUTH_REQUEST:
-                handle_auth_request(hdl, connection_id, payload);
+                handle_auth_request(hdl, connection_id, MessageParser::to_auth_request(parsed));
                 break;
                 
             case MessageParser::MessageType::JOIN_SESSION:
-                handle_join_session(hdl, connection_id, payload);
+                handle_join_session(hdl, connection_id, MessageParser::to_join_session(parsed));
                 break;
                 
             case MessageParser::MessageType::PING:
@@ -190,7 +331,7 @@ void ConnectionHandler::on_message(connection_hdl hdl, message_ptr msg) {
                 break;
                 
             default:
-                handle_command(hdl, connection_id, payload);
+                handle_command(hdl, connection_id, parsed, payload);
                 break;
         }
     } catch (const std::exception& e) {
@@ -208,34 +349,48 @@ void ConnectionHandler::on_fail(connection_hdl hdl) {
 void ConnectionHandler::handle_auth_request(
     connection_hdl hdl,
     const std::string& connection_id,
-    const std::string& message)
+    const MessageParser::AuthRequest& request)
 {
-    auto msg = MessageParser::parse_json(message);
-    
-    std::string device_id = msg["device_id"];
-    std::string secret = msg["secret"];
+    const std::string& device_id = request.device_id;
     
-    // TODO: Validate device credentials
+    if (!device_registry_->authenticate(device_id, request.secret)) {
+        std::cerr << "Device authentication failed: " << device_id << std::endl;
+        std::string error = MessageParser::create_error("AUTH_FAILED", "Invalid device credentials");
+        send(connection_id, error);
+        return;
+    }
     
     // Create session
     std::string session_id = session_manager_->create_session(device_id);
     
     // Generate JWT token
-    auth::JWTManager jwt_mgr("secret_key");  // TODO: Load from config
-    std::string jwt_token = jwt_mgr.generate_token(device_id);
+    std::string jwt_token = jwt_manager_->generate_token(device_id, session_id, {});
+    
+    // The payload key is derived on first use, off this I/O path
+    if (!session_manager_->set_cipher_token(session_id, jwt_token)) {
+        session_manager_->close_session(session_id);
+        std::string error = MessageParser::create_error("INTERNAL", "Session unavailable");
+        send(connection_id, error);
+        return;
+    }
     
     // Update connection info
     {
         std::lock_guard<std::mutex> lock(connections_mutex_);
         auto it = connections_.find(connection_id);
         if (it != connections_.end()) {
+            unindex_connection(it->second);
             it->second->session_id = session_id;
             it->second->user_id = device_id;
             it->second->is_device = true;
             it->second->authenticated = true;
+            it->second->binary_control = request.binary_control;
+            index_connection(it->second);
         }
     }
     
+    stream_router_->register_device(session_id, device_id);
+    
     // Send response
     std::string response = MessageParser::create_auth_response(
         true,
@@ -253,16 +408,13 @@ void ConnectionHandler::handle_auth_request(
 void ConnectionHandler::handle_join_session(
     connection_hdl hdl,
     const std::string& connection_id,
-    const std::string& message)
+    const MessageParser::JoinSessionRequest& request)
 {
-    auto msg = MessageParser::parse_json(message);
-    
-    std::string session_id = msg["session_id"];
-    std::string jwt_token = msg["jwt_token"];
+    const std::string& session_id = request.session_id;
+    const std::string& jwt_token = request.jwt_token;
     
-    // TODO: Validate JWT token
-    auth::JWTManager jwt_mgr("secret_key");
-    if (!jwt_mgr.validate_token(jwt_token)) {
+    // Validate JWT token; repeat joins with the same token hit the cache
+    if (!jwt_manager_->validate_token(jwt_token)) {
         std::string error = MessageParser::create_error("INVALID_TOKEN", "JWT validation failed");
         send(connection_id, error);
         return;
@@ -282,13 +434,31 @@ void ConnectionHandler::handle_join_session(
         std::lock_guard<std::mutex> lock(connections_mutex_);
         auto it = connections_.find(connection_id);
         if (it != connections_.end()) {
+            unindex_connection(it->second);
             it->second->session_id = session_id;
             it->second->user_id = controller_id;
             it->second->is_device = false;
             it->second->authenticated = true;
+            it->second->binary_control = request.binary_control;
+            index_connection(it->second);
         }
     }
     
+    // Resolve the connection once; frames then reach it without touching
+    // connections_mutex_. The sink holds the connection until it is
+    // unregistered on close.
+    websocketpp::lib::error_code ec;
+    server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+    if (ec) {
+        return;
+    }
+    FrameSink sink{con, con->get_raw_socket().native_handle(), send_high_water_mark_};
+    stream_router_->register_controller(
+        session_id,
+        controller_id,
+        [this, sink](const stream::FrameBuffer& frame) { return send_frame(sink, frame); }
+    );
+    
     // Send response
     nlohmann::json device_info = {
         {"device_id", "device_123"},  // TODO: Get from session
@@ -302,7 +472,15 @@ void ConnectionHandler::handle_join_session(
         {"codec", "h264"}
     };
     
-    std::string response = MessageParser::create_join_response(true, device_info, video_config);
+    // Server transcodes binary commands for devices that only speak JSON,
+    // so any controller that asks for binary control gets it
+    nlohmann::json capabilities = nlohmann::json::object();
+    if (request.binary_control) {
+        capabilities["binary_control"] = true;
+    }
+    
+    std::string response = MessageParser::create_join_response(
+        true, device_info, video_config, capabilities);
     send(connection_id, response);
     
     std::cout << "Controller joined session: " << session_id << std::endl;
@@ -311,21 +489,42 @@ void ConnectionHandler::handle_join_session(
 void ConnectionHandler::handle_command(
     connection_hdl hdl,
     const std::string& connection_id,
+    const MessageParser::ParsedMessage& msg,
     const std::string& message)
 {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    
-    auto it = connections_.find(connection_id);
-    if (it == connections_.end() || !it->second->authenticated) {
+    std::string session_id;
+    bool is_device = false;
+    if (!get_sender_route(connection_id, session_id, is_device)) {
         std::string error = MessageParser::create_error("UNAUTHORIZED", "Not authenticated");
         send(connection_id, error);
         return;
     }
     
-    std::string session_id = it->second->session_id;
-    bool is_device = it->second->is_device;
-    
     // Route message to other party
+    if (is_device) {
+        send_to_controller(session_id, message);
+    } else {
+        if (!router::CommandRouter::route_to_device(session_id, msg.body)) {
+            std::string error = MessageParser::create_error("INVALID_COMMAND", "Command failed validation");
+            send(connection_id, error);
+            return;
+        }
+        send_to_device(session_id, message);
+    }
+}
+
+void ConnectionHandler::handle_passthrough_command(
+    const std::string& connection_id,
+    const std::string& message)
+{
+    std::string session_id;
+    bool is_device = false;
+    if (!get_sender_route(connection_id, session_id, is_device)) {
+        std::string error = MessageParser::create_error("UNAUTHORIZED", "Not authenticated");
+        send(connection_id, error);
+        return;
+    }
+    
     if (is_device) {
         send_to_controller(session_id, message);
     } else {
@@ -333,6 +532,193 @@ void ConnectionHandler::handle_command(
     }
 }
 
+bool ConnectionHandler::get_sender_route(
+    const std::string& connection_id,
+    std::string& out_session_id,
+    bool& out_is_device)
+{
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    
+    auto it = connections_.find(connection_id);
+    if (it == connections_.end() || !it->second->authenticated) {
+        return false;
+    }
+    
+    out_session_id = it->second->session_id;
+    out_is_device = it->second->is_device;
+    return true;
+}
+
+void ConnectionHandler::handle_binary_frame(
+    connection_hdl hdl,
+    const std::string& connection_id,
+    message_ptr msg)
+{
+    auto received_at = std::chrono::steady_clock::now();
+    
+    std::string session_id;
+    bool is_device = false;
+    bool binary_control = false;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        
+        auto it = connections_.find(connection_id);
+        if (it == connections_.end() || !it->second->authenticated) {
+            return;
+        }
+        session_id = it->second->session_id;
+        is_device = it->second->is_device;
+        binary_control = it->second->binary_control;
+    }
+    
+    const std::string& payload = msg->get_payload();
+    
+    // Controllers send compact control commands
+    if (!is_device) {
+        if (!binary_control) {
+            std::string error = MessageParser::create_error(
+                "UNSUPPORTED", "Binary control was not negotiated");
+            send(connection_id, error);
+            return;
+        }
+        handle_binary_control(connection_id, session_id, payload);
+        return;
+    }
+    
+    // Parse and validate the CRC once here; downstream hops use the
+    // metadata and treat the frame as trusted. Payloads without the ARCS
+    // header are raw streams and pass through.
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(payload.data());
+    stream::FrameMetadata meta;
+    meta.received_at = received_at;
+    if (protocol::has_frame_magic(bytes, payload.size())) {
+        protocol::FrameHeader header;
+        protocol::FrameStatus status = protocol::parse_frame(bytes, payload.size(), header);
+        if (status != protocol::FrameStatus::OK) {
+            std::cerr << "Dropping invalid frame from " << connection_id << ": "
+                      << protocol::frame_status_to_string(status) << std::endl;
+            return;
+        }
+        meta = stream::FrameMetadata::from_header(header, received_at);
+    }
+    
+    websocketpp::lib::error_code ec;
+    server::connection_ptr con = ws_server_.get_con_from_hdl(hdl, ec);
+    if (ec) {
+        return;
+    }
+    
+    // Build one prepared outgoing message so each controller connection
+    // queues this object instead of framing its own copy. Plaintext
+    // payloads are moved over rather than copied; the received message
+    // stays with websocketpp, just emptied.
+    message_ptr out;
+    if (encrypt_frames_ && meta.has_header &&
+        (meta.flags & protocol::FRAME_FLAG_ENCRYPTED) == 0) {
+        out = encrypt_frame(con, session_id, payload, meta);
+        if (!out) {
+            std::cerr << "Dropping frame from " << connection_id
+                      << ": payload encryption failed" << std::endl;
+            return;
+        }
+    } else {
+        out = con->get_message(websocketpp::frame::opcode::binary, 0);
+        out->get_raw_payload().swap(msg->get_raw_payload());
+    }
+    
+    const std::string& out_payload = out->get_payload();
+    websocketpp::frame::basic_header basic(
+        websocketpp::frame::opcode::binary, out_payload.size(), true, false);
+    websocketpp::frame::extended_header extended(out_payload.size());
+    out->set_header(websocketpp::frame::prepare_header(basic, extended));
+    out->set_prepared(true);
+    
+    // Controllers hold handles to the outgoing message's payload
+    stream_router_->route_frame(
+        session_id,
+        stream::FrameBuffer::wrap(out, reinterpret_cast<const uint8_t*>(out_payload.data()),
+                                  out_payload.size())
+            .with_metadata(meta)
+            .with_prepared(out)
+    );
+}
+
+message_ptr ConnectionHandler::encrypt_frame(
+    const server::connection_ptr& con,
+    const std::string& session_id,
+    const std::string& frame,
+    stream::FrameMetadata& meta)
+{
+    using security::SessionCipher;
+    
+    // First call for the session derives the key
+    std::shared_ptr<SessionCipher> cipher = session_manager_->get_cipher(session_id);
+    if (!cipher) {
+        return nullptr;
+    }
+    
+    const size_t offset = meta.payload_offset;
+    const size_t size = meta.payload_size;
+    const size_t out_size = frame.size() + SessionCipher::OVERHEAD;
+    
+    // The frame is copied once, straight into the outgoing message with
+    // room for the IV and tag, and encrypted there:
+    //   [header][fragment info][IV][ciphertext][tag][CRC32]
+    message_ptr out = con->get_message(websocketpp::frame::opcode::binary, out_size);
+    std::string& raw = out->get_raw_payload();
+    raw.append(frame, 0, offset);
+    raw.append(SessionCipher::IV_SIZE, '\0');
+    raw.append(frame, offset, size);
+    raw.append(SessionCipher::TAG_SIZE + protocol::FRAME_CHECKSUM_SIZE, '\0');
+    
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&raw[0]);
+    if (!cipher->encrypt_in_place(bytes + offset, size)) {
+        return nullptr;
+    }
+    
+    meta.flags |= protocol::FRAME_FLAG_ENCRYPTED;
+    meta.payload_size = static_cast<uint32_t>(size + SessionCipher::OVERHEAD);
+    bytes[FRAME_FLAGS_OFFSET] = meta.flags;
+    write_be32(bytes + FRAME_PAYLOAD_LENGTH_OFFSET, meta.payload_size);
+    
+    size_t covered = out_size - protocol::FRAME_CHECKSUM_SIZE;
+    write_be32(bytes + covered, protocol::crc32(bytes, covered));
+    return out;
+}
+
+void ConnectionHandler::handle_binary_control(
+    const std::string& connection_id,
+    const std::string& session_id,
+    const std::string& payload)
+{
+    MessageParser::BinaryControl cmd;
+    if (!MessageParser::decode_binary_control(
+            reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), cmd)) {
+        std::string error = MessageParser::create_error("INVALID_COMMAND", "Malformed binary command");
+        send(connection_id, error);
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    
+    auto it = session_routes_.find(session_id);
+    if (it == session_routes_.end() || !it->second.device) {
+        return;
+    }
+    
+    const auto& device = it->second.device;
+    try {
+        if (device->binary_control) {
+            ws_server_.send(device->hdl, payload, websocketpp::frame::opcode::binary);
+        } else {
+            ws_server_.send(device->hdl, MessageParser::binary_control_to_json(cmd),
+                            websocketpp::frame::opcode::text);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to send to device: " << e.what() << std::endl;
+    }
+}
+
 std::string ConnectionHandler::get_connection_id(connection_hdl hdl) {
     std::lock_guard<std::mutex> lock(connections_mutex_);
     
@@ -343,5 +729,38 @@ std::string ConnectionHandler::get_connection_id(connection_hdl hdl) {
     return "";
 }
 
+void ConnectionHandler::index_connection(const std::shared_ptr<ConnectionInfo>& conn) {
+    auto& route = session_routes_[conn->session_id];
+    if (conn->is_device) {
+        route.device = conn;
+    } else {
+        route.controllers.push_back(conn);
+    }
+}
+
+void ConnectionHandler::unindex_connection(const std::shared_ptr<ConnectionInfo>& conn) {
+    if (!conn->authenticated) {
+        return;
+    }
+    
+    auto it = session_routes_.find(conn->session_id);
+    if (it == session_routes_.end()) {
+        return;
+    }
+    
+    auto& route = it->second;
+    if (route.device == conn) {
+        route.device.reset();
+    }
+    route.controllers.erase(
+        std::remove(route.controllers.begin(), route.controllers.end(), conn),
+        route.controllers.end()
+    );
+    
+    if (!route.device && route.controllers.empty()) {
+        session_routes_.erase(it);
+    }
+}
+
 } // namespace websocket
 } // namespace arcs
@@ -1,12 +1,30 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <memory>
 #include <functional>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <chrono>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
+#include "message_parser.h"
 
 namespace arcs {
+
+namespace stream {
+class StreamRouter;
+class FrameBuffer;
+struct FrameMetadata;
+}
+
+namespace auth {
+class JWTManager;
+class DeviceRegistry;
+}
+
 namespace websocket {
 
 class SessionManager;
@@ -30,6 +48,15 @@ struct ConnectionInfo {
     bool is_device;
     bool authenticated;
     std::chrono::system_clock::time_point connected_at;
+    bool binary_control;          // Negotiated compact binary commands
+};
+
+/**
+ * Connections participating in one session
+ */
+struct SessionRoute {
+    std::shared_ptr<ConnectionInfo> device;
+    std::vector<std::shared_ptr<ConnectionInfo>> controllers;
 };
 
 /**
@@ -37,13 +64,22 @@ struct ConnectionInfo {
  */
 class ConnectionHandler {
 public:
+    /**
+     * Constructor
+     * @param io_threads Threads running the event loop (0 = one per core)
+     */
     ConnectionHandler(
         std::shared_ptr<SessionManager> session_manager,
-        uint16_t port = 8080
+        std::shared_ptr<stream::StreamRouter> stream_router,
+        std::shared_ptr<auth::JWTManager> jwt_manager,
+        std::shared_ptr<auth::DeviceRegistry> device_registry,
+        uint16_t port = 8080,
+        size_t io_threads = 0
     );
     
     /**
      * Start server
+     * Blocks; the calling thread joins the I/O thread pool
      */
     void start();
     
@@ -63,7 +99,7 @@ public:
     void send_to_device(const std::string& session_id, const std::string& message);
     
     /**
-     * Send message to controller in session
+     * Send message to controllers in session
      */
     void send_to_controller(const std::string& session_id, const std::string& message);
     
@@ -72,6 +108,20 @@ public:
      */
     void broadcast_to_session(const std::string& session_id, const std::string& message);
     
+    /**
+     * Set the queued bytes above which a controller is sent no frames
+     * Each connection is further limited by its own socket send buffer.
+     * Call before start()
+     */
+    void set_send_high_water_mark(size_t bytes);
+    
+    /**
+     * Encrypt video frame payloads with the session cipher before relay
+     * Only for controllers that decrypt; frames the device already
+     * encrypted and raw streams are relayed unchanged. Call before start()
+     */
+    void set_frame_encryption(bool enabled);
+    
     /**
      * Close connection
      */
@@ -91,29 +141,111 @@ private:
     void handle_auth_request(
         connection_hdl hdl,
         const std::string& connection_id,
-        const std::string& message
+        const MessageParser::AuthRequest& request
     );
     
     void handle_join_session(
         connection_hdl hdl,
         const std::string& connection_id,
-        const std::string& message
+        const MessageParser::JoinSessionRequest& request
     );
     
     void handle_command(
         connection_hdl hdl,
         const std::string& connection_id,
+        const MessageParser::ParsedMessage& msg,
         const std::string& message
     );
     
+    /**
+     * Forward whitelisted command bytes without building a DOM
+     */
+    void handle_passthrough_command(
+        const std::string& connection_id,
+        const std::string& message
+    );
+    
+    /**
+     * Look up sender's session and role
+     * @return false if the connection is not authenticated
+     */
+    bool get_sender_route(
+        const std::string& connection_id,
+        std::string& out_session_id,
+        bool& out_is_device
+    );
+    
+    void handle_binary_frame(
+        connection_hdl hdl,
+        const std::string& connection_id,
+        message_ptr msg
+    );
+    
+    /**
+     * Build the outgoing message for a frame with its payload encrypted
+     * Updates meta's flags and payload size to match.
+     * @return nullptr if the session has no usable cipher
+     */
+    message_ptr encrypt_frame(
+        const server::connection_ptr& con,
+        const std::string& session_id,
+        const std::string& frame,
+        stream::FrameMetadata& meta
+    );
+    
+    /**
+     * Forward binary control command to the session's device, as-is if
+     * the device negotiated binary control, otherwise as JSON
+     */
+    void handle_binary_control(
+        const std::string& connection_id,
+        const std::string& session_id,
+        const std::string& payload
+    );
+    
+    /**
+     * Controller connection resolved at join, so frames reach it
+     * without taking the global lock
+     */
+    struct FrameSink {
+        server::connection_ptr con;
+        int fd;                     // Socket queried for queued bytes
+        size_t high_water_mark;
+    };
+    
+    /**
+     * Push binary video frame to a controller connection
+     * @return false if the connection's send queue is above its high-water mark
+     */
+    bool send_frame(const FrameSink& sink, const stream::FrameBuffer& frame);
+    
     std::string get_connection_id(connection_hdl hdl);
     
+    /**
+     * Maintain session routing index (caller holds connections_mutex_)
+     */
+    void index_connection(const std::shared_ptr<ConnectionInfo>& conn);
+    void unindex_connection(const std::shared_ptr<ConnectionInfo>& conn);
+    
     server ws_server_;
     std::shared_ptr<SessionManager> session_manager_;
-    std::map<std::string, std::shared_ptr<ConnectionInfo>> connections_;
+    std::shared_ptr<stream::StreamRouter> stream_router_;
+    std::shared_ptr<auth::JWTManager> jwt_manager_;
+    std::shared_ptr<auth::DeviceRegistry> device_registry_;
+    std::unordered_map<std::string, std::shared_ptr<ConnectionInfo>> connections_;
     std::map<connection_hdl, std::string, std::owner_less<connection_hdl>> hdl_to_id_;
-    std::mutex connections_mutex_;
+    std::unordered_map<std::string, SessionRoute> session_routes_;
+    mutable std::mutex connections_mutex_;
     uint16_t port_;
+    size_t io_threads_;
+    size_t send_high_water_mark_;
+    bool encrypt_frames_;
+    
+    static constexpr size_t DEFAULT_SEND_HIGH_WATER_MARK = 1024 * 1024;  // ~2s at 4 Mbps
+    
+    // Devices fragment large frames (64 KB packets), so no single message
+    // needs to be buffered whole beyond this
+    static constexpr size_t MAX_MESSAGE_SIZE = 1024 * 1024;
 };
 
 } // namespace websocket
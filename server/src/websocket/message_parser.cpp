@@ -1,18 +1,503 @@
 #include "message_parser.h"
 #include <iostream>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
 
 namespace arcs {
 namespace websocket {
 
-MessageParser::MessageType MessageParser::get_message_type(const std::string& json_str) {
-    try {
-        auto msg = parse_json(json_str);
-        if (msg.contains("type")) {
-            return string_to_type(msg["type"]);
+namespace {
+
+/**
+ * Forward-only strict JSON scanner used by peek
+ * Validates everything it skips, so a message it accepts is one the full
+ * parser accepts too. Strings with \u escapes are refused rather than
+ * checked for surrogate pairs; such messages take the slow path.
+ */
+class JsonScanner {
+public:
+    JsonScanner(const char* begin, const char* end) : pos_(begin), end_(end) {}
+    
+    void skip_ws() {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r')) {
+            ++pos_;
         }
-    } catch (...) {
     }
-    return MessageType::UNKNOWN;
+    
+    bool consume(char c) {
+        skip_ws();
+        if (pos_ < end_ && *pos_ == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+    
+    bool peek(char c) {
+        skip_ws();
+        return pos_ < end_ && *pos_ == c;
+    }
+    
+    bool peek_number() {
+        skip_ws();
+        return pos_ < end_ && (*pos_ == '-' || (*pos_ >= '0' && *pos_ <= '9'));
+    }
+    
+    bool at_end() {
+        skip_ws();
+        return pos_ == end_;
+    }
+    
+    /**
+     * Read string token; strings with escapes are reported via out_escaped
+     */
+    bool read_string(const char*& out_begin, const char*& out_end, bool& out_escaped) {
+        if (!consume('"')) {
+            return false;
+        }
+        out_begin = pos_;
+        out_escaped = false;
+        while (pos_ < end_) {
+            auto c = static_cast<unsigned char>(*pos_++);
+            if (c == '"') {
+                out_end = pos_ - 1;
+                return true;
+            }
+            if (c == '\\') {
+                if (pos_ == end_ || std::strchr("\"\\/bfnrt", *pos_) == nullptr || *pos_ == '\0') {
+                    return false;
+                }
+                ++pos_;
+                out_escaped = true;
+            } else if (c < 0x20) {
+                return false;
+            } else if (c >= 0x80 && !skip_utf8(c)) {
+                return false;
+            }
+        }
+        return false;
+    }
+    
+    /**
+     * Read number token
+     * @param out_negative Set if the number has a leading minus
+     */
+    bool read_number(bool& out_negative) {
+        skip_ws();
+        out_negative = pos_ < end_ && *pos_ == '-';
+        if (out_negative) {
+            ++pos_;
+        }
+        if (pos_ == end_) {
+            return false;
+        }
+        if (*pos_ == '0') {
+            ++pos_;
+        } else if (!skip_digits()) {
+            return false;
+        }
+        if (pos_ < end_ && *pos_ == '.') {
+            ++pos_;
+            if (!skip_digits()) {
+                return false;
+            }
+        }
+        if (pos_ < end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+            ++pos_;
+            if (pos_ < end_ && (*pos_ == '+' || *pos_ == '-')) {
+                ++pos_;
+            }
+            if (!skip_digits()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    /**
+     * Skip any JSON value, including nested objects and arrays
+     */
+    bool skip_value(int depth = 0) {
+        skip_ws();
+        if (pos_ == end_ || depth > MAX_DEPTH) {
+            return false;
+        }
+        
+        const char* b;
+        const char* e;
+        bool flag;
+        switch (*pos_) {
+            case '"':
+                return read_string(b, e, flag);
+                
+            case '{':
+                ++pos_;
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    if (!read_string(b, e, flag) || !consume(':') || !skip_value(depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume('}');
+                
+            case '[':
+                ++pos_;
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    if (!skip_value(depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+                
+            case 't':
+                return skip_literal("true");
+            case 'f':
+                return skip_literal("false");
+            case 'n':
+                return skip_literal("null");
+                
+            default:
+                return read_number(flag);
+        }
+    }
+
+private:
+    static constexpr int MAX_DEPTH = 32;
+    
+    bool skip_digits() {
+        const char* start = pos_;
+        while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9') {
+            ++pos_;
+        }
+        return pos_ > start;
+    }
+    
+    bool skip_literal(const char* literal) {
+        size_t length = std::strlen(literal);
+        if (static_cast<size_t>(end_ - pos_) < length || std::memcmp(pos_, literal, length) != 0) {
+            return false;
+        }
+        pos_ += length;
+        return true;
+    }
+    
+    /**
+     * Skip the rest of a UTF-8 sequence whose lead byte was just read,
+     * rejecting overlong forms, surrogates and values past U+10FFFF
+     */
+    bool skip_utf8(unsigned char lead) {
+        int extra;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            extra = 1;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            extra = 2;
+            if (lead == 0xE0) low = 0xA0;
+            if (lead == 0xED) high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            extra = 3;
+            if (lead == 0xF0) low = 0x90;
+            if (lead == 0xF4) high = 0x8F;
+        } else {
+            return false;
+        }
+        
+        for (int i = 0; i < extra; ++i) {
+            if (pos_ == end_) {
+                return false;
+            }
+            auto c = static_cast<unsigned char>(*pos_++);
+            if (c < low || c > high) {
+                return false;
+            }
+            low = 0x80;
+            high = 0xBF;
+        }
+        return true;
+    }
+    
+    const char* pos_;
+    const char* end_;
+};
+
+uint16_t read_u16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t read_u32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) |
+           (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) |
+           static_cast<uint32_t>(p[3]);
+}
+
+bool read_binary_control_capability(const json& body) {
+    auto caps = body.find("capabilities");
+    if (caps == body.end() || !caps->is_object()) {
+        return false;
+    }
+    return caps->value("binary_control", false);
+}
+
+} // namespace
+
+MessageParser::ParsedMessage MessageParser::parse(const std::string& json_str) {
+    ParsedMessage parsed;
+    parsed.body = parse_json(json_str);
+    parsed.type = MessageType::UNKNOWN;
+    
+    auto type_it = parsed.body.find("type");
+    if (type_it != parsed.body.end() && type_it->is_string()) {
+        parsed.type = string_to_type(type_it->get_ref<const std::string&>());
+    }
+    return parsed;
+}
+
+MessageParser::AuthRequest MessageParser::to_auth_request(const ParsedMessage& msg) {
+    AuthRequest request;
+    request.device_id = msg.body.at("device_id").get<std::string>();
+    request.secret = msg.body.at("secret").get<std::string>();
+    request.binary_control = read_binary_control_capability(msg.body);
+    return request;
+}
+
+MessageParser::JoinSessionRequest MessageParser::to_join_session(const ParsedMessage& msg) {
+    JoinSessionRequest request;
+    request.session_id = msg.body.at("session_id").get<std::string>();
+    request.jwt_token = msg.body.at("jwt_token").get<std::string>();
+    request.binary_control = read_binary_control_capability(msg.body);
+    return request;
+}
+
+bool MessageParser::is_binary_control(const uint8_t* data, size_t size) {
+    return size >= CONTROL_HEADER_SIZE &&
+           std::memcmp(data, "ARCS", 4) == 0 &&
+           data[4] == BINARY_VERSION &&
+           data[5] == BINARY_TYPE_CONTROL;
+}
+
+bool MessageParser::decode_binary_control(
+    const uint8_t* data,
+    size_t size,
+    BinaryControl& out)
+{
+    if (!is_binary_control(data, size)) {
+        return false;
+    }
+    
+    out = BinaryControl{};
+    out.command = static_cast<ControlCommand>(data[6]);
+    out.action = data[7];
+    const uint8_t* args = data + CONTROL_HEADER_SIZE;
+    
+    switch (out.command) {
+        case ControlCommand::TOUCH:
+            if (size != CONTROL_TOUCH_SIZE ||
+                out.action < static_cast<uint8_t>(TouchAction::TAP) ||
+                out.action > static_cast<uint8_t>(TouchAction::SWIPE)) {
+                return false;
+            }
+            out.x = read_u16(args);
+            out.y = read_u16(args + 2);
+            out.end_x = read_u16(args + 4);
+            out.end_y = read_u16(args + 6);
+            out.duration_ms = read_u16(args + 8);
+            return true;
+            
+        case ControlCommand::KEY:
+            if (size != CONTROL_KEY_SIZE ||
+                out.action != static_cast<uint8_t>(KeyAction::PRESS)) {
+                return false;
+            }
+            out.keycode = read_u32(args);
+            return true;
+            
+        case ControlCommand::SYSTEM:
+            return size == CONTROL_SYSTEM_SIZE &&
+                   out.action >= static_cast<uint8_t>(SystemAction::HOME) &&
+                   out.action <= static_cast<uint8_t>(SystemAction::SCREENSHOT);
+    }
+    
+    return false;
+}
+
+std::string MessageParser::binary_control_to_json(const BinaryControl& cmd) {
+    char buffer[192];
+    int len = 0;
+    
+    switch (cmd.command) {
+        case ControlCommand::TOUCH:
+            if (cmd.action == static_cast<uint8_t>(TouchAction::SWIPE)) {
+                len = std::snprintf(buffer, sizeof(buffer),
+                    "{\"type\":\"touch\",\"action\":\"swipe\",\"start_x\":%u,\"start_y\":%u,"
+                    "\"end_x\":%u,\"end_y\":%u,\"duration\":%u}",
+                    cmd.x, cmd.y, cmd.end_x, cmd.end_y, cmd.duration_ms);
+            } else {
+                const char* action =
+                    cmd.action == static_cast<uint8_t>(TouchAction::LONG_PRESS) ? "long_press" : "tap";
+                len = std::snprintf(buffer, sizeof(buffer),
+                    "{\"type\":\"touch\",\"action\":\"%s\",\"x\":%u,\"y\":%u,\"duration\":%u}",
+                    action, cmd.x, cmd.y, cmd.duration_ms);
+            }
+            break;
+            
+        case ControlCommand::KEY:
+            len = std::snprintf(buffer, sizeof(buffer),
+                "{\"type\":\"key\",\"action\":\"press\",\"keycode\":%u}",
+                static_cast<unsigned>(cmd.keycode));
+            break;
+            
+        case ControlCommand::SYSTEM: {
+            static const char* const actions[] = {
+                "home", "back", "recents", "notifications",
+                "quick_settings", "lock", "screenshot"
+            };
+            len = std::snprintf(buffer, sizeof(buffer),
+                "{\"type\":\"system\",\"action\":\"%s\"}",
+                actions[cmd.action - static_cast<uint8_t>(SystemAction::HOME)]);
+            break;
+        }
+    }
+    
+    return std::string(buffer, len > 0 ? static_cast<size_t>(len) : 0);
+}
+
+MessageParser::PeekedMessage MessageParser::peek(const std::string& json_str) {
+    PeekedMessage result;
+    if (json_str.size() > PEEK_SCAN_LIMIT) {
+        return result;
+    }
+    
+    static const struct {
+        const char* name;
+        uint32_t field;
+    } tracked[] = {
+        {"x", PeekedMessage::X},
+        {"y", PeekedMessage::Y},
+        {"start_x", PeekedMessage::START_X},
+        {"start_y", PeekedMessage::START_Y},
+        {"end_x", PeekedMessage::END_X},
+        {"end_y", PeekedMessage::END_Y},
+        {"keycode", PeekedMessage::KEYCODE},
+        {"text", PeekedMessage::TEXT}
+    };
+    
+    JsonScanner scanner(json_str.data(), json_str.data() + json_str.size());
+    if (!scanner.consume('{')) {
+        return result;
+    }
+    
+    MessageType type = MessageType::UNKNOWN;
+    std::string action;
+    uint32_t fields = 0;
+    bool found_type = false;
+    bool found_action = false;
+    uint32_t seen = 0;
+    
+    if (!scanner.consume('}')) {
+        do {
+            const char* key_begin;
+            const char* key_end;
+            bool escaped;
+            if (!scanner.read_string(key_begin, key_end, escaped) || !scanner.consume(':')) {
+                return result;
+            }
+            std::string key = escaped ? std::string() : std::string(key_begin, key_end);
+            
+            // Duplicate keys resolve differently across parsers; refuse
+            // them for every key the fast path relies on
+            const char* value_begin;
+            const char* value_end;
+            if (key == "type" || key == "action") {
+                bool& found = key == "type" ? found_type : found_action;
+                if (found || !scanner.peek('"') ||
+                    !scanner.read_string(value_begin, value_end, escaped) || escaped) {
+                    return result;
+                }
+                found = true;
+                if (key == "type") {
+                    type = string_to_type(std::string(value_begin, value_end));
+                } else {
+                    action.assign(value_begin, value_end);
+                }
+                continue;
+            }
+            
+            uint32_t field = 0;
+            for (const auto& entry : tracked) {
+                if (key == entry.name) {
+                    field = entry.field;
+                    break;
+                }
+            }
+            if (field != 0 && (seen & field) != 0) {
+                return result;
+            }
+            seen |= field;
+            
+            // Fields only count when their value has the expected kind
+            if (field == PeekedMessage::TEXT && scanner.peek('"')) {
+                if (!scanner.read_string(value_begin, value_end, escaped)) {
+                    return result;
+                }
+                fields |= field;
+            } else if (field != 0 && field != PeekedMessage::TEXT && scanner.peek_number()) {
+                bool negative;
+                if (!scanner.read_number(negative)) {
+                    return result;
+                }
+                if (!negative) {
+                    fields |= field;
+                }
+            } else if (!scanner.skip_value()) {
+                return result;
+            }
+        } while (scanner.consume(','));
+        
+        if (!scanner.consume('}')) {
+            return result;
+        }
+    }
+    
+    if (scanner.at_end()) {
+        result.type = type;
+        result.action = std::move(action);
+        result.fields = fields;
+    }
+    return result;
+}
+
+bool MessageParser::is_passthrough(const PeekedMessage& msg) {
+    // Same requirements as CommandRouter::validate_command
+    using F = PeekedMessage;
+    uint32_t required;
+    if (msg.type == MessageType::TOUCH) {
+        if (msg.action == "tap" || msg.action == "long_press") {
+            required = F::X | F::Y;
+        } else if (msg.action == "swipe") {
+            required = F::START_X | F::START_Y | F::END_X | F::END_Y;
+        } else {
+            return false;
+        }
+    } else if (msg.type == MessageType::KEY) {
+        if (msg.action == "press") {
+            required = F::KEYCODE;
+        } else if (msg.action == "text") {
+            required = F::TEXT;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return (msg.fields & required) == required;
 }
 
 json MessageParser::parse_json(const std::string& json_str) {
@@ -67,7 +552,8 @@ std::string MessageParser::create_auth_response(
 std::string MessageParser::create_join_response(
     bool success,
     const json& device_info,
-    const json& video_config)
+    const json& video_config,
+    const json& capabilities)
 {
     json response = {
         {"type", "join_response"},
@@ -76,6 +562,10 @@ std::string MessageParser::create_join_response(
         {"video_config", video_config}
     };
     
+    if (!capabilities.empty()) {
+        response["capabilities"] = capabilities;
+    }
+    
     return response.dump();
 }
 
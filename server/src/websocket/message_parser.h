@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
+#include <cstddef>
 #include <nlohmann/json.hpp>
 
 namespace arcs {
@@ -33,9 +35,144 @@ public:
     };
     
     /**
-     * Parse message type
+     * Message parsed once at dispatch
      */
-    static MessageType get_message_type(const std::string& json_str);
+    struct ParsedMessage {
+        MessageType type;
+        json body;
+    };
+    
+    /**
+     * Typed request fields
+     */
+    struct AuthRequest {
+        std::string device_id;
+        std::string secret;
+        bool binary_control;  // Device accepts compact binary commands
+    };
+    
+    struct JoinSessionRequest {
+        std::string session_id;
+        std::string jwt_token;
+        bool binary_control;  // Controller wants to send binary commands
+    };
+    
+    /**
+     * Compact binary control command (docs/protocol.md)
+     * [Magic:4]["ARCS"][Version:1][Type:1][Command:1][Action:1][Args]
+     */
+    enum class ControlCommand : uint8_t {
+        TOUCH = 0x01,
+        KEY = 0x02,
+        SYSTEM = 0x03
+    };
+    
+    enum class TouchAction : uint8_t {
+        TAP = 0x01,
+        LONG_PRESS = 0x02,
+        SWIPE = 0x03
+    };
+    
+    enum class KeyAction : uint8_t {
+        PRESS = 0x01
+    };
+    
+    enum class SystemAction : uint8_t {
+        HOME = 0x01,
+        BACK = 0x02,
+        RECENTS = 0x03,
+        NOTIFICATIONS = 0x04,
+        QUICK_SETTINGS = 0x05,
+        LOCK = 0x06,
+        SCREENSHOT = 0x07
+    };
+    
+    /**
+     * Decoded binary control command
+     * Touch uses x/y (start for swipes), end_x/end_y and duration_ms;
+     * key uses keycode; system uses action only
+     */
+    struct BinaryControl {
+        ControlCommand command;
+        uint8_t action;
+        uint16_t x;
+        uint16_t y;
+        uint16_t end_x;
+        uint16_t end_y;
+        uint16_t duration_ms;
+        uint32_t keycode;
+    };
+    
+    /**
+     * Top-level fields seen by the scanner, for fast-path routing
+     */
+    struct PeekedMessage {
+        enum Field : uint32_t {
+            X = 1 << 0,
+            Y = 1 << 1,
+            START_X = 1 << 2,
+            START_Y = 1 << 3,
+            END_X = 1 << 4,
+            END_Y = 1 << 5,
+            KEYCODE = 1 << 6,
+            TEXT = 1 << 7
+        };
+        
+        MessageType type = MessageType::UNKNOWN;
+        std::string action;     // Empty unless a plain string
+        uint32_t fields = 0;    // Coordinates and keycode are non-negative
+                                // numbers, text is a string
+    };
+    
+    static constexpr uint8_t BINARY_VERSION = 0x01;
+    static constexpr uint8_t BINARY_TYPE_VIDEO_FRAME = 0x02;
+    static constexpr uint8_t BINARY_TYPE_CONTROL = 0x03;
+    
+    /**
+     * Parse message into type and JSON body
+     * @throws json::parse_error on malformed JSON
+     */
+    static ParsedMessage parse(const std::string& json_str);
+    
+    /**
+     * Extract typed requests from a parsed message
+     * @throws json::exception if a required field is missing
+     */
+    static AuthRequest to_auth_request(const ParsedMessage& msg);
+    static JoinSessionRequest to_join_session(const ParsedMessage& msg);
+    
+    /**
+     * Scan a message's top-level fields without building a DOM
+     * Scans at most PEEK_SCAN_LIMIT bytes and checks the whole message is
+     * strict JSON. Type is UNKNOWN if the message is longer, malformed,
+     * contains \u escapes, or has a missing or duplicated tracked key.
+     */
+    static PeekedMessage peek(const std::string& json_str);
+    
+    /**
+     * Check if binary message carries a control command
+     */
+    static bool is_binary_control(const uint8_t* data, size_t size);
+    
+    /**
+     * Decode binary control command in place, without allocating
+     * @return false if the message is truncated or has unknown codes
+     */
+    static bool decode_binary_control(const uint8_t* data, size_t size, BinaryControl& out);
+    
+    /**
+     * Render binary control command as the equivalent JSON command
+     * for devices that did not negotiate binary control
+     */
+    static std::string binary_control_to_json(const BinaryControl& cmd);
+    
+    /**
+     * Check if a peeked command may be forwarded without a full parse
+     * Only touch and key commands carrying the fields
+     * CommandRouter::validate_command requires qualify; everything else
+     * takes the slow path.
+     */
+    static bool is_passthrough(const PeekedMessage& msg);
     
     /**
      * Parse JSON
@@ -63,7 +200,8 @@ public:
     static std::string create_join_response(
         bool success,
         const json& device_info,
-        const json& video_config
+        const json& video_config,
+        const json& capabilities = json::object()
     );
     
     /**
@@ -81,6 +219,13 @@ public:
 
 private:
     static MessageType string_to_type(const std::string& type_str);
+    
+    static constexpr size_t PEEK_SCAN_LIMIT = 512;
+    
+    static constexpr size_t CONTROL_HEADER_SIZE = 8;
+    static constexpr size_t CONTROL_TOUCH_SIZE = CONTROL_HEADER_SIZE + 10;
+    static constexpr size_t CONTROL_KEY_SIZE = CONTROL_HEADER_SIZE + 4;
+    static constexpr size_t CONTROL_SYSTEM_SIZE = CONTROL_HEADER_SIZE;
 };
 
 } // namespace websocket
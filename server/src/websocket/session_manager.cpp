@@ -1,6 +1,8 @@
 #include "session_manager.h"
+#include "../security/session_cipher.h"
 #include <uuid/uuid.h>
 #include <iostream>
+#include <vector>
 
 namespace arcs {
 namespace websocket {
@@ -9,13 +11,18 @@ SessionManager::SessionManager() {
 }
 
 std::string SessionManager::create_session(const std::string& device_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // The device's index shard stays locked until the session is stored,
+    // so concurrent auths of one device agree on a single session
+    auto& index = index_shard(device_index_, device_id);
+    std::unique_lock<std::shared_mutex> index_lock(index.mutex);
     
     // Check if device already has a session
-    for (const auto& [id, session] : sessions_) {
-        if (session->device_id == device_id && session->is_active) {
-            std::cout << "Device already has active session: " << id << std::endl;
-            return id;
+    auto indexed = index.session_ids.find(device_id);
+    if (indexed != index.session_ids.end()) {
+        auto existing = get_session(indexed->second);
+        if (existing && existing->is_active) {
+            std::cout << "Device already has active session: " << existing->session_id << std::endl;
+            return existing->session_id;
         }
     }
     
@@ -34,7 +41,12 @@ std::string SessionManager::create_session(const std::string& device_id) {
     session->last_activity = session->created_at;
     session->is_active = true;
     
-    sessions_[session_id] = session;
+    {
+        auto& shard = shard_for(session_id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.sessions[session_id] = session;
+    }
+    index.session_ids[device_id] = session_id;
     
     std::cout << "Created session: " << session_id 
               << " for device: " << device_id << std::endl;
@@ -46,22 +58,36 @@ bool SessionManager::join_session(
     const std::string& session_id,
     const std::string& controller_id)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = sessions_.find(session_id);
-    if (it == sessions_.end()) {
-        std::cerr << "Session not found: " << session_id << std::endl;
-        return false;
+    std::string previous_controller;
+    {
+        auto& shard = shard_for(session_id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        
+        auto it = shard.sessions.find(session_id);
+        if (it == shard.sessions.end()) {
+            std::cerr << "Session not found: " << session_id << std::endl;
+            return false;
+        }
+        
+        auto& session = it->second;
+        if (!session->is_active) {
+            std::cerr << "Session not active: " << session_id << std::endl;
+            return false;
+        }
+        
+        previous_controller = session->controller_id;
+        session->controller_id = controller_id;
+        session->last_activity = std::chrono::system_clock::now();
     }
     
-    auto& session = it->second;
-    if (!session->is_active) {
-        std::cerr << "Session not active: " << session_id << std::endl;
-        return false;
+    if (!previous_controller.empty() && previous_controller != controller_id) {
+        unindex(controller_index_, previous_controller, session_id);
+    }
+    {
+        auto& index = index_shard(controller_index_, controller_id);
+        std::unique_lock<std::shared_mutex> index_lock(index.mutex);
+        index.session_ids[controller_id] = session_id;
     }
-    
-    session->controller_id = controller_id;
-    session->last_activity = std::chrono::system_clock::now();
     
     std::cout << "Controller " << controller_id 
               << " joined session: " << session_id << std::endl;
@@ -70,86 +96,191 @@ bool SessionManager::join_session(
 }
 
 std::shared_ptr<Session> SessionManager::get_session(const std::string& session_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto& shard = shard_for(session_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
     
-    auto it = sessions_.find(session_id);
-    if (it != sessions_.end()) {
+    auto it = shard.sessions.find(session_id);
+    if (it != shard.sessions.end()) {
         return it->second;
     }
     return nullptr;
 }
 
+bool SessionManager::set_cipher_token(
+    const std::string& session_id,
+    const std::string& jwt_token)
+{
+    auto session = get_session(session_id);
+    if (!session) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(session->cipher_mutex);
+    session->cipher_token = jwt_token;
+    // Holders of the Session pointer read the field without the shard lock
+    std::atomic_store(&session->cipher, std::shared_ptr<security::SessionCipher>());
+    return true;
+}
+
+std::shared_ptr<security::SessionCipher> SessionManager::get_cipher(const std::string& session_id) {
+    auto session = get_session(session_id);
+    if (!session) {
+        return nullptr;
+    }
+    
+    if (auto cipher = std::atomic_load(&session->cipher)) {
+        return cipher;
+    }
+    
+    std::lock_guard<std::mutex> lock(session->cipher_mutex);
+    if (auto cipher = std::atomic_load(&session->cipher)) {
+        return cipher;  // Derived while we waited
+    }
+    if (session->cipher_token.empty()) {
+        return nullptr;
+    }
+    
+    auto cipher = security::SessionCipher::create(session->cipher_token, session->device_id);
+    if (!cipher) {
+        std::cerr << "Session key derivation failed: " << session_id << std::endl;
+        return nullptr;
+    }
+    std::atomic_store(&session->cipher, cipher);
+    return cipher;
+}
+
 void SessionManager::update_activity(const std::string& session_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    auto& shard = shard_for(session_id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
     
-    auto it = sessions_.find(session_id);
-    if (it != sessions_.end()) {
+    auto it = shard.sessions.find(session_id);
+    if (it != shard.sessions.end()) {
         it->second->last_activity = std::chrono::system_clock::now();
     }
 }
 
 bool SessionManager::close_session(const std::string& session_id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = sessions_.find(session_id);
-    if (it != sessions_.end()) {
+    std::string device_id;
+    std::string controller_id;
+    {
+        auto& shard = shard_for(session_id);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        
+        auto it = shard.sessions.find(session_id);
+        if (it == shard.sessions.end()) {
+            return false;
+        }
         it->second->is_active = false;
-        sessions_.erase(it);
-        std::cout << "Closed session: " << session_id << std::endl;
-        return true;
+        device_id = it->second->device_id;
+        controller_id = it->second->controller_id;
+        shard.sessions.erase(it);
     }
-    return false;
+    
+    // Index shards are taken after the session shard is released
+    unindex(device_index_, device_id, session_id);
+    if (!controller_id.empty()) {
+        unindex(controller_index_, controller_id, session_id);
+    }
+    
+    std::cout << "Closed session: " << session_id << std::endl;
+    return true;
 }
 
 std::shared_ptr<Session> SessionManager::get_session_by_device(
     const std::string& device_id)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    for (const auto& [id, session] : sessions_) {
-        if (session->device_id == device_id && session->is_active) {
-            return session;
-        }
-    }
-    return nullptr;
+    return find_indexed(device_index_, device_id, &Session::device_id);
 }
 
 std::shared_ptr<Session> SessionManager::get_session_by_controller(
     const std::string& controller_id)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    for (const auto& [id, session] : sessions_) {
-        if (session->controller_id == controller_id && session->is_active) {
-            return session;
-        }
-    }
-    return nullptr;
+    return find_indexed(controller_index_, controller_id, &Session::controller_id);
 }
 
 size_t SessionManager::get_active_count() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     size_t count = 0;
-    for (const auto& [id, session] : sessions_) {
-        if (session->is_active) {
-            count++;
+    for (const auto& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (const auto& [id, session] : shard.sessions) {
+            if (session->is_active) {
+                count++;
+            }
         }
     }
     return count;
 }
 
 void SessionManager::cleanup_expired() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = sessions_.begin();
-    while (it != sessions_.end()) {
-        if (it->second->is_expired()) {
-            std::cout << "Removing expired session: " << it->first << std::endl;
-            it = sessions_.erase(it);
-        } else {
-            ++it;
+    std::vector<std::shared_ptr<Session>> expired;
+    
+    for (auto& shard : shards_) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        
+        auto it = shard.sessions.begin();
+        while (it != shard.sessions.end()) {
+            if (it->second->is_expired()) {
+                std::cout << "Removing expired session: " << it->first << std::endl;
+                it->second->is_active = false;
+                expired.push_back(it->second);
+                it = shard.sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    for (const auto& session : expired) {
+        unindex(device_index_, session->device_id, session->session_id);
+        if (!session->controller_id.empty()) {
+            unindex(controller_index_, session->controller_id, session->session_id);
+        }
+    }
+}
+
+SessionManager::Shard& SessionManager::shard_for(const std::string& session_id) {
+    return shards_[std::hash<std::string>{}(session_id) % SHARD_COUNT];
+}
+
+SessionManager::IndexShard& SessionManager::index_shard(Index& index, const std::string& key) {
+    return index[std::hash<std::string>{}(key) % SHARD_COUNT];
+}
+
+std::shared_ptr<Session> SessionManager::find_indexed(
+    Index& index,
+    const std::string& key,
+    std::string Session::*member)
+{
+    std::string session_id;
+    {
+        auto& shard = index_shard(index, key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        
+        auto it = shard.session_ids.find(key);
+        if (it == shard.session_ids.end()) {
+            return nullptr;
         }
+        session_id = it->second;
+    }
+    
+    auto& shard = shard_for(session_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    
+    auto it = shard.sessions.find(session_id);
+    if (it == shard.sessions.end() || !it->second->is_active ||
+        (*it->second).*member != key) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void SessionManager::unindex(Index& index, const std::string& key, const std::string& session_id) {
+    auto& shard = index_shard(index, key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    
+    auto it = shard.session_ids.find(key);
+    if (it != shard.session_ids.end() && it->second == session_id) {
+        shard.session_ids.erase(it);
     }
 }
 
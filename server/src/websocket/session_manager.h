@@ -3,10 +3,17 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <array>
 #include <mutex>
+#include <shared_mutex>
 #include <chrono>
 
 namespace arcs {
+
+namespace security {
+class SessionCipher;
+}
+
 namespace websocket {
 
 /**
@@ -20,6 +27,13 @@ struct Session {
     std::chrono::system_clock::time_point last_activity;
     bool is_active;
     
+    // Payload cipher keyed from the session's current JWT, derived on
+    // first use and reset when a new token is issued; access it through
+    // SessionManager. cipher_mutex guards cipher_token and derivation.
+    std::shared_ptr<security::SessionCipher> cipher;
+    std::string cipher_token;
+    std::mutex cipher_mutex;
+    
     bool is_expired() const {
         auto now = std::chrono::system_clock::now();
         auto idle = std::chrono::duration_cast<std::chrono::seconds>(
@@ -58,6 +72,20 @@ public:
      */
     void update_activity(const std::string& session_id);
     
+    /**
+     * Set the token the session's payload cipher is keyed from
+     * Cheap; the key is derived by the first get_cipher call
+     */
+    bool set_cipher_token(const std::string& session_id,
+                          const std::string& jwt_token);
+    
+    /**
+     * Get the session's payload cipher (nullptr if none)
+     * The first call per token runs the key derivation (100k PBKDF2
+     * rounds); concurrent callers wait for it rather than repeat it.
+     */
+    std::shared_ptr<security::SessionCipher> get_cipher(const std::string& session_id);
+    
     /**
      * Close session
      */
@@ -84,8 +112,50 @@ public:
     void cleanup_expired();
 
 private:
-    std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
-    std::mutex mutex_;
+    static constexpr size_t SHARD_COUNT = 64;
+    
+    /**
+     * Session table shard, selected by session ID hash
+     */
+    struct Shard {
+        std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+        mutable std::shared_mutex mutex;
+    };
+    
+    /**
+     * Secondary index shard (device or controller ID -> session ID)
+     * Entries are hints: lookups confirm them against the session, and
+     * stale ones are overwritten or erased lazily.
+     */
+    struct IndexShard {
+        std::unordered_map<std::string, std::string> session_ids;
+        mutable std::shared_mutex mutex;
+    };
+    
+    using Index = std::array<IndexShard, SHARD_COUNT>;
+    
+    Shard& shard_for(const std::string& session_id);
+    static IndexShard& index_shard(Index& index, const std::string& key);
+    
+    /**
+     * Active session the index maps key to, if its member still matches
+     */
+    std::shared_ptr<Session> find_indexed(
+        Index& index,
+        const std::string& key,
+        std::string Session::*member
+    );
+    
+    /**
+     * Erase key if it still points at session_id
+     */
+    static void unindex(Index& index, const std::string& key, const std::string& session_id);
+    
+    // Lock order: an index shard may be held while taking a session
+    // shard, never the reverse
+    std::array<Shard, SHARD_COUNT> shards_;
+    Index device_index_;
+    Index controller_index_;
 };
 
 } // namespace websocket
@@ -0,0 +1,76 @@
+#include "test_support.h"
+#include "protocol/crc32.h"
+#include <zlib.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using arcs::protocol::crc32;
+using arcs::protocol::crc32_slice8;
+
+namespace {
+
+uint32_t zlib_crc32(const uint8_t* data, size_t size) {
+    return static_cast<uint32_t>(::crc32(0L, data, static_cast<uInt>(size)));
+}
+
+void test_check_value() {
+    const char* digits = "123456789";
+    const auto* data = reinterpret_cast<const uint8_t*>(digits);
+    CHECK(crc32(data, 9) == 0xCBF43926u);
+    CHECK(crc32_slice8(data, 9) == 0xCBF43926u);
+    CHECK(crc32(nullptr, 0) == 0);
+}
+
+/**
+ * Every length up to a few folding blocks, at every alignment, so both
+ * the short-input path and the PCLMUL head/tail handling are covered
+ */
+void test_matches_zlib(const std::vector<uint8_t>& buffer) {
+    for (size_t offset = 0; offset < 16; ++offset) {
+        for (size_t size = 0; size <= 512; ++size) {
+            const uint8_t* data = buffer.data() + offset;
+            uint32_t expected = zlib_crc32(data, size);
+            if (crc32(data, size) != expected || crc32_slice8(data, size) != expected) {
+                std::cerr << "mismatch at offset " << offset << " size " << size << std::endl;
+                CHECK(crc32(data, size) == expected);
+                CHECK(crc32_slice8(data, size) == expected);
+                return;
+            }
+        }
+    }
+    
+    for (size_t size : {4096u, 65536u + 7u, 1024u * 1024u - 3u}) {
+        CHECK(crc32(buffer.data() + 1, size) == zlib_crc32(buffer.data() + 1, size));
+        CHECK(crc32_slice8(buffer.data() + 1, size) == zlib_crc32(buffer.data() + 1, size));
+    }
+}
+
+void test_continuation(const std::vector<uint8_t>& buffer) {
+    const size_t total = 10000;
+    uint32_t expected = zlib_crc32(buffer.data(), total);
+    for (size_t split : {0u, 1u, 63u, 64u, 1000u, 9999u, 10000u}) {
+        uint32_t head = crc32(buffer.data(), split);
+        CHECK(crc32(buffer.data() + split, total - split, head) == expected);
+        
+        uint32_t head8 = crc32_slice8(buffer.data(), split);
+        CHECK(crc32_slice8(buffer.data() + split, total - split, head8) == expected);
+    }
+}
+
+} // anonymous namespace
+
+int main() {
+    std::mt19937 rng(12345);
+    std::vector<uint8_t> buffer(1024 * 1024 + 16);
+    for (auto& byte : buffer) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    
+    std::cout << "crc32 implementation: " << arcs::protocol::crc32_implementation() << std::endl;
+    
+    test_check_value();
+    test_matches_zlib(buffer);
+    test_continuation(buffer);
+    return arcs::test::result();
+}
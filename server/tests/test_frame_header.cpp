@@ -0,0 +1,155 @@
+#include "test_support.h"
+#include "protocol/frame_header.h"
+#include "protocol/crc32.h"
+#include "stream/frame_buffer.h"
+#include <vector>
+
+using namespace arcs::protocol;
+
+namespace {
+
+void put_be(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+/**
+ * Encode one frame as the device does (docs/protocol.md)
+ */
+std::vector<uint8_t> encode_frame(uint32_t frame_number,
+                                  uint64_t timestamp_us,
+                                  uint8_t flags,
+                                  const std::vector<uint8_t>& payload,
+                                  uint16_t fragment_index = 0,
+                                  uint16_t fragment_count = 1) {
+    std::vector<uint8_t> out = {'A', 'R', 'C', 'S', FRAME_VERSION, FRAME_TYPE_VIDEO};
+    put_be(out, frame_number, 4);
+    put_be(out, timestamp_us, 8);
+    out.push_back(flags);
+    put_be(out, payload.size(), 4);
+    if (flags & FRAME_FLAG_FRAGMENT) {
+        put_be(out, fragment_index, 2);
+        put_be(out, fragment_count, 2);
+    }
+    out.insert(out.end(), payload.begin(), payload.end());
+    put_be(out, crc32(out.data(), out.size()), 4);
+    return out;
+}
+
+void rewrite_crc(std::vector<uint8_t>& frame) {
+    size_t covered = frame.size() - FRAME_CHECKSUM_SIZE;
+    frame.resize(covered);
+    put_be(frame, crc32(frame.data(), covered), 4);
+}
+
+void test_whole_frame() {
+    std::vector<uint8_t> payload = {0, 0, 0, 1, 0x65, 0x88, 0x84};
+    auto frame = encode_frame(0x01020304, 0x1122334455667788ull, FRAME_FLAG_KEYFRAME, payload);
+    CHECK(frame.size() == FRAME_HEADER_SIZE + payload.size() + FRAME_CHECKSUM_SIZE);
+    CHECK(has_frame_magic(frame.data(), frame.size()));
+    
+    FrameHeader header;
+    CHECK(parse_frame(frame.data(), frame.size(), header) == FrameStatus::OK);
+    CHECK(header.version == FRAME_VERSION);
+    CHECK(header.type == FRAME_TYPE_VIDEO);
+    CHECK(header.frame_number == 0x01020304);
+    CHECK(header.timestamp_us == 0x1122334455667788ull);
+    CHECK(header.is_keyframe());
+    CHECK(!header.is_fragment());
+    CHECK(!header.is_encrypted());
+    CHECK(header.payload_size == payload.size());
+    CHECK(header.payload_offset == FRAME_HEADER_SIZE);
+    CHECK(header.fragment_index == 0);
+    CHECK(header.fragment_count == 1);
+}
+
+void test_fragment() {
+    std::vector<uint8_t> payload(100, 0xAB);
+    auto frame = encode_frame(7, 1000, FRAME_FLAG_FRAGMENT, payload, 2, 3);
+    CHECK(frame.size() == FRAME_HEADER_SIZE + FRAME_FRAGMENT_INFO_SIZE +
+                          payload.size() + FRAME_CHECKSUM_SIZE);
+    
+    FrameHeader header;
+    CHECK(parse_frame(frame.data(), frame.size(), header) == FrameStatus::OK);
+    CHECK(header.is_fragment());
+    CHECK(!header.is_keyframe());
+    CHECK(header.fragment_index == 2);
+    CHECK(header.fragment_count == 3);
+    CHECK(header.payload_offset == FRAME_HEADER_SIZE + FRAME_FRAGMENT_INFO_SIZE);
+    CHECK(header.payload_size == payload.size());
+    CHECK(frame[header.payload_offset] == 0xAB);
+    
+    // Metadata carried with the buffer mirrors the header
+    auto received_at = std::chrono::steady_clock::now();
+    auto meta = arcs::stream::FrameMetadata::from_header(header, received_at);
+    CHECK(meta.has_header);
+    CHECK(meta.frame_number == 7);
+    CHECK(meta.timestamp_us == 1000);
+    CHECK(meta.is_fragment());
+    CHECK(meta.fragment_index == 2);
+    CHECK(meta.fragment_count == 3);
+    CHECK(meta.payload_offset == header.payload_offset);
+    CHECK(meta.payload_size == payload.size());
+    CHECK(meta.received_at == received_at);
+}
+
+void test_bad_fragment_info() {
+    std::vector<uint8_t> payload(8, 1);
+    FrameHeader header;
+    
+    auto index_past_count = encode_frame(1, 0, FRAME_FLAG_FRAGMENT, payload, 3, 3);
+    CHECK(parse_frame(index_past_count.data(), index_past_count.size(), header) ==
+          FrameStatus::BAD_LENGTH);
+    
+    auto zero_count = encode_frame(1, 0, FRAME_FLAG_FRAGMENT, payload, 0, 0);
+    CHECK(parse_frame(zero_count.data(), zero_count.size(), header) == FrameStatus::BAD_LENGTH);
+    
+    // Fragment flag set but too short to hold the fragment info
+    std::vector<uint8_t> empty;
+    auto truncated = encode_frame(1, 0, FRAME_FLAG_FRAGMENT, empty, 0, 1);
+    truncated.erase(truncated.begin() + FRAME_HEADER_SIZE, truncated.begin() + FRAME_HEADER_SIZE + 2);
+    CHECK(parse_frame(truncated.data(), truncated.size(), header) == FrameStatus::TRUNCATED);
+}
+
+void test_rejects_corruption() {
+    std::vector<uint8_t> payload(32, 0x42);
+    auto good = encode_frame(9, 9, 0, payload);
+    FrameHeader header;
+    
+    CHECK(parse_frame(good.data(), FRAME_HEADER_SIZE, header) == FrameStatus::TRUNCATED);
+    
+    auto bad_magic = good;
+    bad_magic[0] = 'X';
+    CHECK(parse_frame(bad_magic.data(), bad_magic.size(), header) == FrameStatus::BAD_MAGIC);
+    CHECK(!has_frame_magic(bad_magic.data(), bad_magic.size()));
+    
+    auto bad_version = good;
+    bad_version[4] = 0x02;
+    CHECK(parse_frame(bad_version.data(), bad_version.size(), header) == FrameStatus::BAD_VERSION);
+    
+    // Declared length must match the message exactly
+    auto extra = good;
+    extra.insert(extra.end() - FRAME_CHECKSUM_SIZE, 0x00);
+    rewrite_crc(extra);
+    CHECK(parse_frame(extra.data(), extra.size(), header) == FrameStatus::BAD_LENGTH);
+    
+    auto flipped = good;
+    flipped[FRAME_HEADER_SIZE + 5] ^= 0x01;
+    CHECK(parse_frame(flipped.data(), flipped.size(), header) == FrameStatus::BAD_CHECKSUM);
+    
+    // Trusted hops only parse the header
+    CHECK(parse_frame(flipped.data(), flipped.size(), header, FrameValidation::TRUSTED) ==
+          FrameStatus::OK);
+    CHECK(header.frame_number == 9);
+}
+
+} // anonymous namespace
+
+int main() {
+    test_whole_frame();
+    test_fragment();
+    test_bad_fragment_info();
+    test_rejects_corruption();
+    return arcs::test::result();
+}
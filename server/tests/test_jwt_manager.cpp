@@ -0,0 +1,105 @@
+#include "test_support.h"
+#include "auth/jwt_manager.h"
+#include <string>
+
+using arcs::auth::JWTManager;
+
+namespace {
+
+const char* const SECRET = "test-secret";
+
+void test_validate_and_cache() {
+    JWTManager manager(SECRET, 1);
+    std::string token = manager.generate_token("device-1", "session-1", {});
+    
+    auto payload = manager.validate_token(token);
+    CHECK(payload.has_value());
+    CHECK(payload && payload->device_id == "device-1");
+    CHECK(payload && payload->session_id == "session-1");
+    CHECK(payload && payload->expires_at > payload->issued_at);
+    
+    // Second presentation is served from the cache with the same payload
+    auto cached = manager.validate_token(token);
+    CHECK(cached.has_value());
+    CHECK(cached && payload && cached->device_id == payload->device_id);
+    CHECK(cached && payload && cached->session_id == payload->session_id);
+    CHECK(cached && payload && cached->expires_at == payload->expires_at);
+    CHECK(!manager.is_expired(token));
+}
+
+void test_rejects_forgery() {
+    JWTManager manager(SECRET, 1);
+    std::string token = manager.generate_token("device-1", "session-1", {});
+    CHECK(manager.validate_token(token).has_value());
+    
+    // A cached token must not make a modified copy of it acceptable
+    // (inside the signature; the last character carries padding bits)
+    std::string tampered = token;
+    char& c = tampered[tampered.size() - 5];
+    c = c == 'a' ? 'b' : 'a';
+    CHECK(!manager.validate_token(tampered).has_value());
+    
+    JWTManager other("other-secret", 1);
+    CHECK(!other.validate_token(token).has_value());
+    CHECK(!manager.validate_token("not.a.token").has_value());
+}
+
+void test_revocation() {
+    JWTManager manager(SECRET, 1);
+    std::string revoked = manager.generate_token("device-1", "session-1", {});
+    std::string kept = manager.generate_token("device-1", "session-2", {});
+    
+    // Validate first so revocation has a cache entry to evict
+    CHECK(manager.validate_token(revoked).has_value());
+    CHECK(manager.validate_token(kept).has_value());
+    CHECK(!manager.is_revoked(revoked));
+    
+    manager.revoke_token(revoked);
+    CHECK(manager.is_revoked(revoked));
+    CHECK(!manager.validate_token(revoked).has_value());
+    
+    CHECK(!manager.is_revoked(kept));
+    CHECK(manager.validate_token(kept).has_value());
+    
+    // Later revocations keep earlier unexpired ones
+    manager.revoke_token(kept);
+    CHECK(manager.is_revoked(revoked));
+    CHECK(manager.is_revoked(kept));
+}
+
+void test_expired() {
+    // Zero validity: the token is already expired when checked
+    JWTManager manager(SECRET, 0);
+    std::string token = manager.generate_token("device-1", "session-1", {});
+    CHECK(!manager.validate_token(token).has_value());
+    CHECK(manager.is_expired(token));
+    
+    // Nothing to keep for a token that can no longer validate
+    manager.revoke_token(token);
+    CHECK(!manager.is_revoked(token));
+}
+
+void test_cache_beyond_capacity() {
+    JWTManager manager(SECRET, 1);
+    std::string first = manager.generate_token("device-0", "session-0", {});
+    CHECK(manager.validate_token(first).has_value());
+    
+    // Push the first token out of the LRU; it must still verify in full
+    for (int i = 1; i <= 5000; ++i) {
+        std::string id = std::to_string(i);
+        manager.validate_token(manager.generate_token("device-" + id, "session-" + id, {}));
+    }
+    auto payload = manager.validate_token(first);
+    CHECK(payload && payload->session_id == "session-0");
+}
+
+} // anonymous namespace
+
+int main() {
+    test_validate_and_cache();
+    test_rejects_forgery();
+    test_revocation();
+    test_expired();
+    test_cache_beyond_capacity();
+    return arcs::test::result();
+}
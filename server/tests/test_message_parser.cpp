@@ -0,0 +1,146 @@
+#include "test_support.h"
+#include "websocket/message_parser.h"
+#include "router/command_router.h"
+#include <iterator>
+#include <string>
+#include <vector>
+
+using arcs::websocket::MessageParser;
+using arcs::websocket::json;
+
+namespace {
+
+std::vector<uint8_t> control(uint8_t command, uint8_t action, std::vector<uint8_t> args = {}) {
+    const uint8_t header[] = {'A', 'R', 'C', 'S', MessageParser::BINARY_VERSION,
+                              MessageParser::BINARY_TYPE_CONTROL, command, action};
+    args.insert(args.begin(), std::begin(header), std::end(header));
+    return args;
+}
+
+bool decode(const std::vector<uint8_t>& message, MessageParser::BinaryControl& out) {
+    return MessageParser::decode_binary_control(message.data(), message.size(), out);
+}
+
+/**
+ * Transcoded JSON must parse and pass the router's checks
+ */
+json to_json(const MessageParser::BinaryControl& cmd) {
+    json body = json::parse(MessageParser::binary_control_to_json(cmd));
+    CHECK(arcs::router::CommandRouter::validate_command(body));
+    return body;
+}
+
+void test_touch() {
+    // x=540 y=1200 end_x=540 end_y=300 duration=250
+    auto swipe = control(0x01, 0x03, {0x02, 0x1C, 0x04, 0xB0, 0x02, 0x1C, 0x01, 0x2C, 0x00, 0xFA});
+    CHECK(MessageParser::is_binary_control(swipe.data(), swipe.size()));
+    
+    MessageParser::BinaryControl cmd;
+    CHECK(decode(swipe, cmd));
+    CHECK(cmd.command == MessageParser::ControlCommand::TOUCH);
+    CHECK(cmd.x == 540 && cmd.y == 1200);
+    CHECK(cmd.end_x == 540 && cmd.end_y == 300);
+    CHECK(cmd.duration_ms == 250);
+    
+    json body = to_json(cmd);
+    CHECK(body["type"] == "touch");
+    CHECK(body["action"] == "swipe");
+    CHECK(body["start_x"] == 540 && body["start_y"] == 1200);
+    CHECK(body["end_x"] == 540 && body["end_y"] == 300);
+    CHECK(body["duration"] == 250);
+    
+    auto long_press = control(0x01, 0x02, {0x00, 0x0A, 0x00, 0x14, 0, 0, 0, 0, 0x03, 0xE8});
+    CHECK(decode(long_press, cmd));
+    body = to_json(cmd);
+    CHECK(body["action"] == "long_press");
+    CHECK(body["x"] == 10 && body["y"] == 20);
+    CHECK(body["duration"] == 1000);
+    
+    auto tap = control(0x01, 0x01, std::vector<uint8_t>(10, 0));
+    CHECK(decode(tap, cmd));
+    CHECK(to_json(cmd)["action"] == "tap");
+}
+
+void test_key_and_system() {
+    MessageParser::BinaryControl cmd;
+    auto key = control(0x02, 0x01, {0x00, 0x00, 0x00, 0x42});
+    CHECK(decode(key, cmd));
+    CHECK(cmd.command == MessageParser::ControlCommand::KEY);
+    CHECK(cmd.keycode == 66);
+    json body = to_json(cmd);
+    CHECK(body["type"] == "key" && body["action"] == "press" && body["keycode"] == 66);
+    
+    const char* const actions[] = {
+        "home", "back", "recents", "notifications", "quick_settings", "lock", "screenshot"
+    };
+    for (uint8_t action = 0x01; action <= 0x07; ++action) {
+        CHECK(decode(control(0x03, action), cmd));
+        body = to_json(cmd);
+        CHECK(body["type"] == "system");
+        CHECK(body["action"] == actions[action - 1]);
+    }
+}
+
+void test_rejects_malformed() {
+    MessageParser::BinaryControl cmd;
+    
+    auto truncated = control(0x01, 0x01, std::vector<uint8_t>(9, 0));
+    CHECK(!decode(truncated, cmd));
+    auto oversized = control(0x02, 0x01, std::vector<uint8_t>(5, 0));
+    CHECK(!decode(oversized, cmd));
+    
+    CHECK(!decode(control(0x01, 0x04, std::vector<uint8_t>(10, 0)), cmd));
+    CHECK(!decode(control(0x02, 0x02, std::vector<uint8_t>(4, 0)), cmd));
+    CHECK(!decode(control(0x03, 0x00), cmd));
+    CHECK(!decode(control(0x03, 0x08), cmd));
+    CHECK(!decode(control(0x04, 0x01), cmd));
+    
+    auto video = control(0x01, 0x01, std::vector<uint8_t>(10, 0));
+    video[5] = MessageParser::BINARY_TYPE_VIDEO_FRAME;
+    CHECK(!decode(video, cmd));
+    
+    auto short_header = control(0x03, 0x01);
+    CHECK(!MessageParser::decode_binary_control(short_header.data(), 7, cmd));
+}
+
+bool passthrough(const std::string& message) {
+    return MessageParser::is_passthrough(MessageParser::peek(message));
+}
+
+void test_passthrough_scan() {
+    CHECK(passthrough(R"({"type":"touch","action":"tap","x":10,"y":20})"));
+    CHECK(passthrough(R"({"type":"touch","action":"swipe","start_x":1,"start_y":2,"end_x":3.5,"end_y":4e2})"));
+    CHECK(passthrough(R"({"type":"key","action":"press","keycode":66})"));
+    CHECK(passthrough(R"({"type":"key","action":"text","text":"a\"b"})"));
+    CHECK(passthrough(R"({"type":"touch","action":"tap","x":1,"y":2,"m":{"a":[true,false,null,-1e-3]}})"));
+    
+    // Missing, negative or mistyped fields take the slow path
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":10})"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":-1,"y":2})"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":"1","y":2})"));
+    CHECK(!passthrough(R"({"type":"key","action":"press","keycode":null})"));
+    CHECK(!passthrough(R"({"type":"system","action":"home"})"));
+    
+    // So does anything the scanner cannot vouch for as strict JSON
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":1,"y":2,"z":bogus})"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":1,"y":2,"z":tru})"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":01,"y":2})"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":1,"y":2,"z":[1,,2]})"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":1,"y":2,"x":3})"));
+    CHECK(!passthrough(R"({"type":"touch","type":"key","action":"tap","x":1,"y":2})"));
+    CHECK(!passthrough(R"({"type":"key","action":"text","text":"\u0041"})"));
+    CHECK(!passthrough("{\"type\":\"key\",\"action\":\"text\",\"text\":\"\xff\"}"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":1,"y":2} x)"));
+    CHECK(!passthrough(R"({"type":"touch","action":"tap","x":1,"y":2,"pad":")" +
+                       std::string(512, 'a') + "\"}"));
+}
+
+} // anonymous namespace
+
+int main() {
+    test_touch();
+    test_key_and_system();
+    test_rejects_malformed();
+    test_passthrough_scan();
+    return arcs::test::result();
+}
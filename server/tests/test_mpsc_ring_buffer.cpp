@@ -0,0 +1,134 @@
+#include "test_support.h"
+#include "logger/mpsc_ring_buffer.h"
+#include <thread>
+#include <vector>
+
+using arcs::logger::MpscRingBuffer;
+
+namespace {
+
+void test_capacity() {
+    CHECK(MpscRingBuffer<int>(0).capacity() == 2);
+    CHECK(MpscRingBuffer<int>(1).capacity() == 2);
+    CHECK(MpscRingBuffer<int>(2).capacity() == 2);
+    CHECK(MpscRingBuffer<int>(3).capacity() == 4);
+    CHECK(MpscRingBuffer<int>(1000).capacity() == 1024);
+}
+
+void test_full_and_empty() {
+    MpscRingBuffer<int> ring(4);
+    int value = -1;
+    CHECK(!ring.try_pop(value));
+    
+    for (int i = 0; i < 4; ++i) {
+        CHECK(ring.try_push(i));
+    }
+    CHECK(!ring.try_push(99));
+    CHECK(ring.size_approx() == 4);
+    
+    // One slot freed admits exactly one more
+    CHECK(ring.try_pop(value) && value == 0);
+    CHECK(ring.try_push(4));
+    CHECK(!ring.try_push(100));
+    
+    for (int expected = 1; expected <= 4; ++expected) {
+        CHECK(ring.try_pop(value) && value == expected);
+    }
+    CHECK(!ring.try_pop(value));
+    CHECK(ring.size_approx() == 0);
+}
+
+void test_single_slot_request() {
+    // A requested capacity of 1 must not let a push overwrite an unread value
+    MpscRingBuffer<int> ring(1);
+    int value = -1;
+    CHECK(ring.try_push(1));
+    CHECK(ring.try_push(2));
+    CHECK(!ring.try_push(3));
+    CHECK(ring.try_pop(value) && value == 1);
+    CHECK(ring.try_pop(value) && value == 2);
+    CHECK(!ring.try_pop(value));
+}
+
+void test_wraparound() {
+    MpscRingBuffer<int> ring(8);
+    int next_push = 0;
+    int next_pop = 0;
+    int value = -1;
+    
+    // Uneven batches so positions wrap at every offset many times over
+    for (int round = 0; round < 1000; ++round) {
+        int pushes = 1 + round % 7;
+        for (int i = 0; i < pushes && ring.try_push(next_push); ++i) {
+            ++next_push;
+        }
+        int pops = 1 + (round * 3) % 6;
+        for (int i = 0; i < pops && ring.try_pop(value); ++i) {
+            CHECK(value == next_pop);
+            ++next_pop;
+        }
+    }
+    while (ring.try_pop(value)) {
+        CHECK(value == next_pop);
+        ++next_pop;
+    }
+    CHECK(next_pop == next_push);
+    CHECK(next_push > 1000);
+}
+
+void test_concurrent_producers() {
+    const int producers = 4;
+    const int per_producer = 100000;
+    MpscRingBuffer<int> ring(64);
+    
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&ring, p]() {
+            for (int i = 0; i < per_producer; ++i) {
+                int value = p * per_producer + i;
+                while (!ring.try_push(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    
+    // Every value arrives once, and each producer's values stay in order
+    std::vector<int> last_seen(producers, -1);
+    std::vector<bool> seen(static_cast<size_t>(producers) * per_producer, false);
+    int received = 0;
+    bool ordered = true;
+    bool unique = true;
+    int value = -1;
+    while (received < producers * per_producer) {
+        if (!ring.try_pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        int p = value / per_producer;
+        int i = value % per_producer;
+        ordered = ordered && i > last_seen[p];
+        last_seen[p] = i;
+        unique = unique && !seen[value];
+        seen[value] = true;
+        ++received;
+    }
+    
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(ordered);
+    CHECK(unique);
+    CHECK(!ring.try_pop(value));
+}
+
+} // anonymous namespace
+
+int main() {
+    test_capacity();
+    test_full_and_empty();
+    test_single_slot_request();
+    test_wraparound();
+    test_concurrent_producers();
+    return arcs::test::result();
+}
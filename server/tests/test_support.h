@@ -0,0 +1,36 @@
+#pragma once
+
+#include <iostream>
+
+namespace arcs {
+namespace test {
+
+/**
+ * Minimal checks for the unit tests
+ * Unlike assert they stay active in release builds, and every failure is
+ * reported before the test exits non-zero.
+ */
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int result() {
+    if (failures() > 0) {
+        std::cerr << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace test
+} // namespace arcs
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__                        \
+                      << ": CHECK failed: " #cond << std::endl;             \
+            ++arcs::test::failures();                                       \
+        }                                                                   \
+    } while (0)
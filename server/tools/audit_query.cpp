@@ -0,0 +1,154 @@
+/**
+ * arcs-audit-query
+ * Search binary audit segments written by AuditLogger (Format::BINARY).
+ *
+ * Usage:
+ *   arcs-audit-query [--since T] [--until T] [--session ID] [--user ID]
+ *                    [--count] <segment-dir | segment-file>...
+ *
+ * T is epoch milliseconds or UTC "YYYY-MM-DDTHH:MM:SS". Segments whose
+ * header time bounds miss the range are skipped without reading entries.
+ */
+
+#include "logger/audit_segment.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/stat.h>
+
+using arcs::logger::AuditEntry;
+using arcs::logger::AuditQuery;
+using arcs::logger::AuditSegmentReader;
+
+namespace {
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program
+              << " [--since T] [--until T] [--session ID] [--user ID] [--count]"
+              << " <segment-dir | segment-file>...\n"
+              << "  T is epoch milliseconds or UTC YYYY-MM-DDTHH:MM:SS" << std::endl;
+}
+
+bool parse_time(const char* text, int64_t& out) {
+    char* end = nullptr;
+    long long ms = std::strtoll(text, &end, 10);
+    if (end != text && *end == '\0') {
+        out = ms;
+        return true;
+    }
+
+    std::tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    end = strptime(text, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (!end || (*end != '\0' && std::strcmp(end, "Z") != 0)) {
+        return false;
+    }
+    out = static_cast<int64_t>(timegm(&tm)) * 1000;
+    return true;
+}
+
+const char* level_name(uint8_t level) {
+    static const char* const names[] = {"INFO", "WARN", "ERROR", "CRIT"};
+    return level < 4 ? names[level] : "UNKNOWN";
+}
+
+void print_entry(const AuditEntry& entry) {
+    std::time_t seconds = static_cast<std::time_t>(entry.timestamp_ms / 1000);
+    int millis = static_cast<int>(entry.timestamp_ms % 1000);
+    if (millis < 0) {
+        seconds -= 1;
+        millis += 1000;
+    }
+
+    std::tm tm;
+    gmtime_r(&seconds, &tm);
+    char timestamp[32];
+    size_t length = std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+    std::snprintf(timestamp + length, sizeof(timestamp) - length, ".%03dZ", millis);
+
+    std::cout << timestamp << " | " << level_name(entry.level)
+              << " | " << entry.event_type
+              << " | user=" << entry.user_id;
+    if (!entry.session_id.empty()) {
+        std::cout << " | session=" << entry.session_id;
+    }
+    std::cout << " | " << entry.message;
+    if (!entry.details.empty()) {
+        std::cout << " | " << entry.details;
+    }
+    std::cout << '\n';
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    AuditQuery query;
+    bool count_only = false;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if ((arg == "--since" || arg == "--until") && has_value) {
+            int64_t& target = arg == "--since" ? query.since_ms : query.until_ms;
+            if (!parse_time(argv[++i], target)) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--session" && has_value) {
+            query.session_id = argv[++i];
+        } else if (arg == "--user" && has_value) {
+            query.user_id = argv[++i];
+        } else if (arg == "--count") {
+            count_only = true;
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> segments;
+    for (const auto& input : inputs) {
+        struct stat st;
+        if (stat(input.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            auto listed = AuditSegmentReader::list_segments(input);
+            segments.insert(segments.end(), listed.begin(), listed.end());
+        } else {
+            segments.push_back(input);
+        }
+    }
+
+    size_t matched = 0;
+    for (const auto& path : segments) {
+        AuditSegmentReader reader(path);
+        if (!reader.is_open()) {
+            continue;
+        }
+
+        if (count_only) {
+            matched += reader.scan(query, [](const AuditEntry&) {});
+        } else {
+            matched += reader.scan(query, print_entry);
+        }
+    }
+
+    if (count_only) {
+        std::cout << matched << std::endl;
+    }
+
+    return 0;
+}